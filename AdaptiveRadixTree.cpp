@@ -0,0 +1,610 @@
+//
+// Adaptive radix tree (ART) over song titles. Same insert/search as Trie,
+// but every node only takes as much room as its fan-out needs, so the key
+// alphabet is the full byte range.
+//
+
+#include "AdaptiveRadixTree.h"
+#include "TitleKey.h"
+#include <algorithm>
+#include <bit>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// shrink a size below its grow point so one insert/erase pair can't bounce
+constexpr uint32_t shrink16At = 3;
+constexpr uint32_t shrink48At = 12;
+constexpr uint32_t shrink256At = 37;
+
+// the prefix pool is compacted once at least this much and half of it is dead
+constexpr size_t compactAtDeadBytes = 4096;
+
+// index of the first key not below byte: where byte is, or where it would go
+uint32_t insertPosition(const uint8_t *keys, uint32_t count, uint8_t byte) {
+    uint32_t i = 0;
+    while (i < count && keys[i] < byte)
+        ++i;
+    return i;
+}
+
+}
+
+AdaptiveRadixTree::AdaptiveRadixTree() {
+    root = allocate(pool4, Type4);
+}
+
+template <typename Node>
+uint32_t AdaptiveRadixTree::allocate(Pool<Node> &pool, NodeType type) {
+    uint32_t index;
+    if (!pool.freed.empty()) {
+        index = pool.freed.back();
+        pool.freed.pop_back();
+        pool.nodes[index] = Node {};
+    } else {
+        index = static_cast<uint32_t>(pool.nodes.size());
+        pool.nodes.emplace_back();
+    }
+    if constexpr (std::is_same_v<Node, Node256>)
+        std::fill(std::begin(pool.nodes[index].children), std::end(pool.nodes[index].children), none);
+    return (static_cast<uint32_t>(type) << typeShift) | index;
+}
+
+void AdaptiveRadixTree::release(uint32_t ref) {
+    switch (typeOf(ref)) {
+        case Type4: pool4.freed.push_back(indexOf(ref)); break;
+        case Type16: pool16.freed.push_back(indexOf(ref)); break;
+        case Type48: pool48.freed.push_back(indexOf(ref)); break;
+        case Type256: pool256.freed.push_back(indexOf(ref)); break;
+    }
+}
+
+AdaptiveRadixTree::Header &AdaptiveRadixTree::header(uint32_t ref) {
+    return const_cast<Header &>(static_cast<const AdaptiveRadixTree *>(this)->header(ref));
+}
+
+const AdaptiveRadixTree::Header &AdaptiveRadixTree::header(uint32_t ref) const {
+    switch (typeOf(ref)) {
+        case Type4: return pool4.nodes[indexOf(ref)].header;
+        case Type16: return pool16.nodes[indexOf(ref)].header;
+        case Type48: return pool48.nodes[indexOf(ref)].header;
+        default: return pool256.nodes[indexOf(ref)].header;
+    }
+}
+
+size_t AdaptiveRadixTree::nodeCount() const {
+    return pool4.nodes.size() - pool4.freed.size() + pool16.nodes.size() - pool16.freed.size()
+         + pool48.nodes.size() - pool48.freed.size() + pool256.nodes.size() - pool256.freed.size();
+}
+
+size_t AdaptiveRadixTree::memoryUsage() const {
+    return pool4.nodes.capacity() * sizeof(Node4) + pool16.nodes.capacity() * sizeof(Node16)
+         + pool48.nodes.capacity() * sizeof(Node48) + pool256.nodes.capacity() * sizeof(Node256)
+         + (pool4.freed.capacity() + pool16.freed.capacity() + pool48.freed.capacity()
+            + pool256.freed.capacity() + freedSongs.capacity()) * sizeof(uint32_t)
+         + songEntries.capacity() * sizeof(SongEntry) + prefixPool.capacity();
+}
+
+uint32_t AdaptiveRadixTree::findChild(uint32_t ref, uint8_t byte) const {
+    switch (typeOf(ref)) {
+        case Type4: {
+            const Node4 &node = pool4.nodes[indexOf(ref)];
+            for (uint32_t i = 0; i < node.header.childCount; ++i) {
+                if (node.keys[i] == byte)
+                    return node.children[i];
+            }
+            return none;
+        }
+        case Type16: {
+            const Node16 &node = pool16.nodes[indexOf(ref)];
+#if defined(__SSE2__)
+            // compare all 16 keys at once, then mask off the unused slots
+            __m128i hits = _mm_cmpeq_epi8(_mm_set1_epi8(static_cast<char>(byte)),
+                                          _mm_load_si128(reinterpret_cast<const __m128i *>(node.keys)));
+            uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(hits)) & ((1u << node.header.childCount) - 1);
+            return mask ? node.children[std::countr_zero(mask)] : none;
+#else
+            for (uint32_t i = 0; i < node.header.childCount; ++i) {
+                if (node.keys[i] == byte)
+                    return node.children[i];
+            }
+            return none;
+#endif
+        }
+        case Type48: {
+            const Node48 &node = pool48.nodes[indexOf(ref)];
+            uint8_t slot = node.slotOf[byte];
+            return slot ? node.children[slot - 1] : none;
+        }
+        default:
+            return pool256.nodes[indexOf(ref)].children[byte];
+    }
+}
+
+// overwrites the child that byte already leads to
+void AdaptiveRadixTree::setChild(uint32_t ref, uint8_t byte, uint32_t child) {
+    switch (typeOf(ref)) {
+        case Type4: {
+            Node4 &node = pool4.nodes[indexOf(ref)];
+            node.children[insertPosition(node.keys, node.header.childCount, byte)] = child;
+            break;
+        }
+        case Type16: {
+            Node16 &node = pool16.nodes[indexOf(ref)];
+            node.children[insertPosition(node.keys, node.header.childCount, byte)] = child;
+            break;
+        }
+        case Type48: {
+            Node48 &node = pool48.nodes[indexOf(ref)];
+            node.children[node.slotOf[byte] - 1] = child;
+            break;
+        }
+        case Type256:
+            pool256.nodes[indexOf(ref)].children[byte] = child;
+            break;
+    }
+}
+
+uint32_t AdaptiveRadixTree::addChild(uint32_t ref, uint8_t byte, uint32_t child) {
+    switch (typeOf(ref)) {
+        case Type4: {
+            Node4 &node = pool4.nodes[indexOf(ref)];
+            uint32_t count = node.header.childCount;
+            if (count < 4) {
+                uint32_t at = insertPosition(node.keys, count, byte);
+                std::copy_backward(node.keys + at, node.keys + count, node.keys + count + 1);
+                std::copy_backward(node.children + at, node.children + count, node.children + count + 1);
+                node.keys[at] = byte;
+                node.children[at] = child;
+                ++node.header.childCount;
+                return ref;
+            }
+            uint32_t grown = allocate(pool16, Type16);
+            Node4 &old = pool4.nodes[indexOf(ref)];
+            Node16 &bigger = pool16.nodes[indexOf(grown)];
+            bigger.header = old.header;
+            std::copy(old.keys, old.keys + 4, bigger.keys);
+            std::copy(old.children, old.children + 4, bigger.children);
+            release(ref);
+            return addChild(grown, byte, child);
+        }
+        case Type16: {
+            Node16 &node = pool16.nodes[indexOf(ref)];
+            uint32_t count = node.header.childCount;
+            if (count < 16) {
+                uint32_t at = insertPosition(node.keys, count, byte);
+                std::copy_backward(node.keys + at, node.keys + count, node.keys + count + 1);
+                std::copy_backward(node.children + at, node.children + count, node.children + count + 1);
+                node.keys[at] = byte;
+                node.children[at] = child;
+                ++node.header.childCount;
+                return ref;
+            }
+            uint32_t grown = allocate(pool48, Type48);
+            Node16 &old = pool16.nodes[indexOf(ref)];
+            Node48 &bigger = pool48.nodes[indexOf(grown)];
+            bigger.header = old.header;
+            for (uint32_t i = 0; i < 16; ++i) {
+                bigger.slotOf[old.keys[i]] = static_cast<uint8_t>(i + 1);
+                bigger.children[i] = old.children[i];
+            }
+            release(ref);
+            return addChild(grown, byte, child);
+        }
+        case Type48: {
+            Node48 &node = pool48.nodes[indexOf(ref)];
+            uint32_t count = node.header.childCount;
+            if (count < 48) {
+                // slots are kept packed, so the next free one is always at count
+                node.children[count] = child;
+                node.slotOf[byte] = static_cast<uint8_t>(count + 1);
+                ++node.header.childCount;
+                return ref;
+            }
+            uint32_t grown = allocate(pool256, Type256);
+            Node48 &old = pool48.nodes[indexOf(ref)];
+            Node256 &bigger = pool256.nodes[indexOf(grown)];
+            bigger.header = old.header;
+            for (int b = 0; b < 256; ++b) {
+                if (old.slotOf[b])
+                    bigger.children[b] = old.children[old.slotOf[b] - 1];
+            }
+            release(ref);
+            return addChild(grown, byte, child);
+        }
+        default: {
+            Node256 &node = pool256.nodes[indexOf(ref)];
+            node.children[byte] = child;
+            ++node.header.childCount;
+            return ref;
+        }
+    }
+}
+
+uint32_t AdaptiveRadixTree::removeChild(uint32_t ref, uint8_t byte) {
+    switch (typeOf(ref)) {
+        case Type4: {
+            Node4 &node = pool4.nodes[indexOf(ref)];
+            uint32_t count = node.header.childCount;
+            uint32_t at = insertPosition(node.keys, count, byte);
+            std::copy(node.keys + at + 1, node.keys + count, node.keys + at);
+            std::copy(node.children + at + 1, node.children + count, node.children + at);
+            --node.header.childCount;
+            return ref;
+        }
+        case Type16: {
+            Node16 &node = pool16.nodes[indexOf(ref)];
+            uint32_t count = node.header.childCount;
+            uint32_t at = insertPosition(node.keys, count, byte);
+            std::copy(node.keys + at + 1, node.keys + count, node.keys + at);
+            std::copy(node.children + at + 1, node.children + count, node.children + at);
+            if (--node.header.childCount > shrink16At)
+                return ref;
+            uint32_t shrunk = allocate(pool4, Type4);
+            Node16 &old = pool16.nodes[indexOf(ref)];
+            Node4 &smaller = pool4.nodes[indexOf(shrunk)];
+            smaller.header = old.header;
+            std::copy(old.keys, old.keys + old.header.childCount, smaller.keys);
+            std::copy(old.children, old.children + old.header.childCount, smaller.children);
+            release(ref);
+            return shrunk;
+        }
+        case Type48: {
+            Node48 &node = pool48.nodes[indexOf(ref)];
+            uint32_t slot = node.slotOf[byte] - 1;
+            uint32_t last = --node.header.childCount;
+            node.slotOf[byte] = 0;
+            // keep the slots packed by moving the last one into the hole
+            if (slot != last) {
+                for (int b = 0; b < 256; ++b) {
+                    if (node.slotOf[b] == last + 1) {
+                        node.slotOf[b] = static_cast<uint8_t>(slot + 1);
+                        node.children[slot] = node.children[last];
+                        break;
+                    }
+                }
+            }
+            if (node.header.childCount > shrink48At)
+                return ref;
+            uint32_t shrunk = allocate(pool16, Type16);
+            Node48 &old = pool48.nodes[indexOf(ref)];
+            Node16 &smaller = pool16.nodes[indexOf(shrunk)];
+            smaller.header = old.header;
+            uint32_t next = 0;
+            for (int b = 0; b < 256; ++b) {
+                if (old.slotOf[b]) {
+                    smaller.keys[next] = static_cast<uint8_t>(b);
+                    smaller.children[next++] = old.children[old.slotOf[b] - 1];
+                }
+            }
+            release(ref);
+            return shrunk;
+        }
+        default: {
+            Node256 &node = pool256.nodes[indexOf(ref)];
+            node.children[byte] = none;
+            if (--node.header.childCount > shrink256At)
+                return ref;
+            uint32_t shrunk = allocate(pool48, Type48);
+            Node256 &old = pool256.nodes[indexOf(ref)];
+            Node48 &smaller = pool48.nodes[indexOf(shrunk)];
+            smaller.header = old.header;
+            uint32_t next = 0;
+            for (int b = 0; b < 256; ++b) {
+                if (old.children[b] != none) {
+                    smaller.children[next] = old.children[b];
+                    smaller.slotOf[b] = static_cast<uint8_t>(++next);
+                }
+            }
+            release(ref);
+            return shrunk;
+        }
+    }
+}
+
+uint32_t AdaptiveRadixTree::onlyChild(uint32_t ref, uint8_t &byte) const {
+    for (int b = 0; b < 256; ++b) {
+        uint32_t child = findChild(ref, static_cast<uint8_t>(b));
+        if (child != none) {
+            byte = static_cast<uint8_t>(b);
+            return child;
+        }
+    }
+    return none;
+}
+
+void AdaptiveRadixTree::replaceIn(uint32_t parent, uint8_t byte, uint32_t child) {
+    if (parent == none)
+        root = child;
+    else
+        setChild(parent, byte, child);
+}
+
+uint32_t AdaptiveRadixTree::newLeaf(std::string_view rest) {
+    uint32_t leaf = allocate(pool4, Type4);
+    Header &node = header(leaf);
+    node.prefixOffset = static_cast<uint32_t>(prefixPool.size());
+    node.prefixLength = static_cast<uint32_t>(rest.size());
+    prefixPool += rest;
+    return leaf;
+}
+
+void AdaptiveRadixTree::addSong(uint32_t ref, uint32_t songId) {
+    uint32_t entry;
+    if (!freedSongs.empty()) {
+        entry = freedSongs.back();
+        freedSongs.pop_back();
+        songEntries[entry] = {songId, none};
+    } else {
+        entry = static_cast<uint32_t>(songEntries.size());
+        songEntries.push_back({songId, none});
+    }
+    Header &node = header(ref);
+    if (node.firstSong == none)
+        node.firstSong = entry;
+    else
+        songEntries[node.lastSong].next = entry;
+    node.lastSong = entry;
+}
+
+void AdaptiveRadixTree::insert(std::string_view songName, uint32_t songId) {
+    std::string key = titleKey(songName);
+    uint32_t parent = none;
+    uint8_t parentByte = 0;
+    uint32_t ref = root;
+    size_t depth = 0;
+
+    while (true) {
+        const Header &node = header(ref);
+        std::string_view compressed = prefix(node);
+        std::string_view rest = std::string_view(key).substr(depth);
+        size_t common = std::mismatch(compressed.begin(), compressed.end(), rest.begin(), rest.end()).first
+                      - compressed.begin();
+
+        if (common < compressed.size()) {
+            // the key leaves the compressed path part way, split it there
+            auto oldByte = static_cast<uint8_t>(compressed[common]);
+            uint32_t split = allocate(pool4, Type4);
+            Header &old = header(ref);
+            Header &head = header(split);
+            head.prefixOffset = old.prefixOffset;
+            head.prefixLength = static_cast<uint32_t>(common);
+            old.prefixOffset += static_cast<uint32_t>(common + 1);
+            old.prefixLength -= static_cast<uint32_t>(common + 1);
+            ++deadPrefixBytes; // the byte that is now the edge to old
+            addChild(split, oldByte, ref);
+            replaceIn(parent, parentByte, split);
+            ref = split;
+        }
+        depth += common;
+
+        if (depth == key.size()) {
+            addSong(ref, songId);
+            return;
+        }
+
+        auto byte = static_cast<uint8_t>(key[depth]);
+        uint32_t child = findChild(ref, byte);
+        if (child == none) {
+            uint32_t leaf = newLeaf(std::string_view(key).substr(depth + 1));
+            uint32_t grown = addChild(ref, byte, leaf);
+            if (grown != ref)
+                replaceIn(parent, parentByte, grown);
+            addSong(leaf, songId);
+            return;
+        }
+        parent = ref;
+        parentByte = byte;
+        ref = child;
+        ++depth;
+    }
+}
+
+uint32_t AdaptiveRadixTree::findNode(std::string_view query) const {
+    std::string key = titleKey(query);
+    uint32_t ref = root;
+    size_t depth = 0;
+
+    while (true) {
+        std::string_view compressed = prefix(header(ref));
+        std::string_view rest = std::string_view(key).substr(depth);
+        size_t common = std::min(compressed.size(), rest.size());
+        if (compressed.compare(0, common, rest, 0, common) != 0)
+            return none;
+        // a query that stops inside the compressed path still matches everything below
+        if (rest.size() <= compressed.size())
+            return ref;
+        depth += compressed.size();
+
+        ref = findChild(ref, static_cast<uint8_t>(key[depth]));
+        if (ref == none)
+            return none;
+        ++depth;
+    }
+}
+
+void AdaptiveRadixTree::search(std::string_view query, std::vector<uint32_t> &results,
+                               size_t limit, size_t offset) const {
+    uint32_t ref = findNode(query);
+    if (ref != none)
+        collectSongs(ref, results, limit, offset);
+}
+
+size_t AdaptiveRadixTree::count(std::string_view query) const {
+    uint32_t ref = findNode(query);
+    if (ref == none)
+        return 0;
+    size_t songs = 0;
+    visitSongs(ref, [&](uint32_t) {
+        ++songs;
+        return true;
+    });
+    return songs;
+}
+
+void AdaptiveRadixTree::collectSongs(uint32_t ref, std::vector<uint32_t> &results,
+                                     size_t limit, size_t offset) const {
+    if (limit == 0)
+        return;
+    size_t added = 0;
+    visitSongs(ref, [&](uint32_t songId) {
+        if (offset) {
+            --offset;
+            return true;
+        }
+        results.push_back(songId);
+        return ++added < limit;
+    });
+}
+
+// depth first with an explicit stack, children pushed in reverse byte order
+// so they come off sorted, and it stops as soon as visit says so
+template <typename Visit>
+void AdaptiveRadixTree::visitSongs(uint32_t ref, Visit visit) const {
+    std::vector<uint32_t> stack {ref};
+    while (!stack.empty()) {
+        uint32_t current = stack.back();
+        stack.pop_back();
+        for (uint32_t entry = header(current).firstSong; entry != none; entry = songEntries[entry].next) {
+            if (!visit(songEntries[entry].songId))
+                return;
+        }
+
+        switch (typeOf(current)) {
+            case Type4: {
+                const Node4 &inner = pool4.nodes[indexOf(current)];
+                for (uint32_t i = inner.header.childCount; i-- > 0;)
+                    stack.push_back(inner.children[i]);
+                break;
+            }
+            case Type16: {
+                const Node16 &inner = pool16.nodes[indexOf(current)];
+                for (uint32_t i = inner.header.childCount; i-- > 0;)
+                    stack.push_back(inner.children[i]);
+                break;
+            }
+            case Type48: {
+                const Node48 &inner = pool48.nodes[indexOf(current)];
+                for (int b = 255; b >= 0; --b) {
+                    if (inner.slotOf[b])
+                        stack.push_back(inner.children[inner.slotOf[b] - 1]);
+                }
+                break;
+            }
+            case Type256: {
+                const Node256 &inner = pool256.nodes[indexOf(current)];
+                for (int b = 255; b >= 0; --b) {
+                    if (inner.children[b] != none)
+                        stack.push_back(inner.children[b]);
+                }
+                break;
+            }
+        }
+    }
+}
+
+bool AdaptiveRadixTree::erase(std::string_view songName, uint32_t songId) {
+    std::string key = titleKey(songName);
+    // every node above ref and the byte taken out of it
+    std::vector<std::pair<uint32_t, uint8_t>> path;
+    uint32_t ref = root;
+    size_t depth = 0;
+
+    while (true) {
+        std::string_view compressed = prefix(header(ref));
+        if (std::string_view(key).substr(depth, compressed.size()) != compressed)
+            return false;
+        depth += compressed.size();
+        if (depth == key.size())
+            break;
+        auto byte = static_cast<uint8_t>(key[depth]);
+        uint32_t child = findChild(ref, byte);
+        if (child == none)
+            return false;
+        path.emplace_back(ref, byte);
+        ref = child;
+        ++depth;
+    }
+
+    Header &node = header(ref);
+    uint32_t previous = none;
+    uint32_t entry = node.firstSong;
+    while (entry != none && songEntries[entry].songId != songId) {
+        previous = entry;
+        entry = songEntries[entry].next;
+    }
+    if (entry == none)
+        return false;
+    if (previous == none)
+        node.firstSong = songEntries[entry].next;
+    else
+        songEntries[previous].next = songEntries[entry].next;
+    if (node.lastSong == entry)
+        node.lastSong = previous;
+    freedSongs.push_back(entry);
+
+    auto parentOf = [&](size_t up) {
+        return path.size() > up ? path[path.size() - 1 - up] : std::pair<uint32_t, uint8_t> {none, 0};
+    };
+
+    // drop nodes that no longer lead to any song, shrinking their parents
+    while (ref != root && header(ref).firstSong == none && header(ref).childCount == 0) {
+        auto [parent, byte] = parentOf(0);
+        auto [grandparent, parentByte] = parentOf(1);
+        deadPrefixBytes += header(ref).prefixLength;
+        release(ref);
+        uint32_t shrunk = removeChild(parent, byte);
+        if (shrunk != parent)
+            replaceIn(grandparent, parentByte, shrunk);
+        ref = shrunk;
+        path.pop_back();
+    }
+
+    // a songless node with one child is just part of the child's path now
+    if (ref != root && header(ref).firstSong == none && header(ref).childCount == 1) {
+        uint8_t byte = 0;
+        uint32_t child = onlyChild(ref, byte);
+        std::string merged = std::string(prefix(header(ref))) + static_cast<char>(byte)
+                           + std::string(prefix(header(child)));
+        Header &below = header(child);
+        deadPrefixBytes += header(ref).prefixLength + below.prefixLength;
+        below.prefixOffset = static_cast<uint32_t>(prefixPool.size());
+        below.prefixLength = static_cast<uint32_t>(merged.size());
+        prefixPool += merged;
+
+        auto [parent, parentByte] = parentOf(0);
+        replaceIn(parent, parentByte, child);
+        release(ref);
+    }
+
+    if (deadPrefixBytes >= compactAtDeadBytes && deadPrefixBytes * 2 >= prefixPool.size())
+        compactPrefixes();
+    return true;
+}
+
+void AdaptiveRadixTree::compactPrefixes() {
+    std::string compacted;
+    compacted.reserve(prefixPool.size() - deadPrefixBytes);
+    auto moveLive = [&](auto &pool) {
+        std::vector<bool> freed(pool.nodes.size(), false);
+        for (uint32_t index : pool.freed)
+            freed[index] = true;
+        for (size_t i = 0; i < pool.nodes.size(); ++i) {
+            if (freed[i])
+                continue;
+            Header &node = pool.nodes[i].header;
+            std::string_view span = prefix(node);
+            node.prefixOffset = static_cast<uint32_t>(compacted.size());
+            compacted += span;
+        }
+    };
+    moveLive(pool4);
+    moveLive(pool16);
+    moveLive(pool48);
+    moveLive(pool256);
+    prefixPool = std::move(compacted);
+    deadPrefixBytes = 0;
+}
@@ -0,0 +1,123 @@
+//
+// Adaptive radix tree (ART) over song titles. Same insert/search as Trie,
+// but every node only takes as much room as its fan-out needs, so the key
+// alphabet is the full byte range.
+//
+
+#ifndef ADAPTIVERADIXTREE_H
+#define ADAPTIVERADIXTREE_H
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class AdaptiveRadixTree {
+public:
+    AdaptiveRadixTree();
+
+    // songId is the song's index in the song table, the tree only keeps that
+    void insert(std::string_view songName, uint32_t songId);
+    // appends the ids of songs whose title starts with query, skipping the
+    // first offset matches and stopping after limit of them
+    void search(std::string_view query, std::vector<uint32_t> &results,
+                size_t limit = SIZE_MAX, size_t offset = 0) const;
+    // removes one song added with insert, false if it is not in the tree
+    bool erase(std::string_view songName, uint32_t songId);
+    // how many songs search() would return with no limit
+    size_t count(std::string_view query) const;
+
+    size_t nodeCount() const;
+    size_t memoryUsage() const;
+
+private:
+    static constexpr uint32_t none = UINT32_MAX;
+
+    // a node ref is the node type in the top two bits and an index into that
+    // type's pool in the rest
+    enum NodeType : uint32_t { Type4 = 0, Type16 = 1, Type48 = 2, Type256 = 3 };
+    static constexpr uint32_t typeShift = 30;
+    static constexpr uint32_t indexMask = (1u << typeShift) - 1;
+
+    // the compressed path is a span of prefixPool, songs are the keys that end here
+    struct Header {
+        uint32_t prefixOffset = 0;
+        uint32_t prefixLength = 0;
+        uint32_t firstSong = none;
+        uint32_t lastSong = none;
+        uint32_t childCount = 0;
+    };
+    struct Node4 {
+        Header header;
+        uint8_t keys[4];
+        uint32_t children[4];
+    };
+    struct Node16 {
+        Header header;
+        alignas(16) uint8_t keys[16];
+        uint32_t children[16];
+    };
+    struct Node48 {
+        Header header;
+        uint8_t slotOf[256]; // 0 = no child, otherwise slot + 1
+        uint32_t children[48];
+    };
+    struct Node256 {
+        Header header;
+        uint32_t children[256];
+    };
+
+    struct SongEntry {
+        uint32_t songId;
+        uint32_t next;
+    };
+
+    template <typename Node>
+    struct Pool {
+        std::vector<Node> nodes;
+        std::vector<uint32_t> freed;
+    };
+
+    static NodeType typeOf(uint32_t ref) { return static_cast<NodeType>(ref >> typeShift); }
+    static uint32_t indexOf(uint32_t ref) { return ref & indexMask; }
+
+    template <typename Node>
+    uint32_t allocate(Pool<Node> &pool, NodeType type);
+    void release(uint32_t ref);
+
+    Header &header(uint32_t ref);
+    const Header &header(uint32_t ref) const;
+    std::string_view prefix(const Header &node) const {
+        return {prefixPool.data() + node.prefixOffset, node.prefixLength};
+    }
+
+    uint32_t findChild(uint32_t ref, uint8_t byte) const;
+    // node everything starting with query is under, or none
+    uint32_t findNode(std::string_view query) const;
+    void setChild(uint32_t ref, uint8_t byte, uint32_t child);
+    // both return the node's ref afterwards, which changes when it grows or shrinks
+    uint32_t addChild(uint32_t ref, uint8_t byte, uint32_t child);
+    uint32_t removeChild(uint32_t ref, uint8_t byte);
+    uint32_t onlyChild(uint32_t ref, uint8_t &byte) const;
+    void replaceIn(uint32_t parent, uint8_t byte, uint32_t child);
+    uint32_t newLeaf(std::string_view rest);
+    void addSong(uint32_t ref, uint32_t songId);
+    void collectSongs(uint32_t ref, std::vector<uint32_t> &results, size_t limit, size_t offset) const;
+    // calls visit(song id) for the songs under ref in search order, until it returns false
+    template <typename Visit>
+    void visitSongs(uint32_t ref, Visit visit) const;
+    // copies the live prefixes into a new pool, dropping the spans nothing points at
+    void compactPrefixes();
+
+    uint32_t root;
+    Pool<Node4> pool4;
+    Pool<Node16> pool16;
+    Pool<Node48> pool48;
+    Pool<Node256> pool256;
+    std::vector<SongEntry> songEntries;
+    std::vector<uint32_t> freedSongs;
+    std::string prefixPool;
+    // bytes of prefixPool no node uses any more, left behind by splits and erases
+    size_t deadPrefixBytes = 0;
+};
+
+#endif //ADAPTIVERADIXTREE_H
@@ -0,0 +1,79 @@
+//
+// Index from normalized artist name to that artist's songs. The distinct
+// artist keys are sorted and every artist's song ids sit together in one
+// postings array in the same order, so all songs by artists starting with
+// a prefix are one contiguous slice of it.
+//
+
+#include "ArtistIndex.h"
+#include "BranchlessSearch.h"
+#include "TitleKey.h"
+#include <algorithm>
+#include <numeric>
+
+void ArtistIndex::build(const std::vector<Songs> &songs) {
+    // the csv lists an artist's songs together, only normalize when the name changes
+    std::vector<std::string> keyOf(songs.size());
+    std::string_view lastAuthor;
+    for (size_t i = 0; i < songs.size(); ++i) {
+        if (i > 0 && songs[i].author == lastAuthor)
+            keyOf[i] = keyOf[i - 1];
+        else
+            keyOf[i] = titleKey(songs[i].author);
+        lastAuthor = songs[i].author;
+    }
+    songIds.resize(songs.size());
+    std::iota(songIds.begin(), songIds.end(), 0u);
+    std::stable_sort(songIds.begin(), songIds.end(), [&](uint32_t a, uint32_t b) { return keyOf[a] < keyOf[b]; });
+
+    keys.clear();
+    keyOffsets.assign(1, 0);
+    artistStarts.clear();
+    for (size_t i = 0; i < songIds.size(); ++i) {
+        const std::string &key = keyOf[songIds[i]];
+        if (i == 0 || key != keyOf[songIds[i - 1]]) {
+            keys += key;
+            keyOffsets.push_back(static_cast<uint32_t>(keys.size()));
+            artistStarts.push_back(static_cast<uint32_t>(i));
+        }
+    }
+    artistStarts.push_back(static_cast<uint32_t>(songIds.size()));
+    keys.shrink_to_fit();
+}
+
+size_t ArtistIndex::lowerBound(std::string_view key) const {
+    return branchlessLowerBound(artistCount(), [&](size_t i) { return keyAt(i) < key; });
+}
+
+void ArtistIndex::range(std::string_view key, size_t &first, size_t &last) const {
+    if (artistStarts.empty()) {
+        first = last = 0;
+        return;
+    }
+    size_t firstArtist = lowerBound(key);
+    std::string successor;
+    size_t lastArtist = keySuccessor(key, successor) ? lowerBound(successor) : artistCount();
+    first = artistStarts[firstArtist];
+    last = artistStarts[lastArtist];
+}
+
+void ArtistIndex::search(std::string_view query, std::vector<uint32_t> &results, size_t limit,
+                         size_t offset) const {
+    size_t first, last;
+    range(titleKey(query), first, last);
+    if (offset >= last - first)
+        return;
+    first += offset;
+    last = first + std::min(limit, last - first);
+    results.insert(results.end(), songIds.begin() + first, songIds.begin() + last);
+}
+
+size_t ArtistIndex::count(std::string_view query) const {
+    size_t first, last;
+    range(titleKey(query), first, last);
+    return last - first;
+}
+
+size_t ArtistIndex::memoryUsage() const {
+    return keys.capacity() + (keyOffsets.capacity() + artistStarts.capacity() + songIds.capacity()) * sizeof(uint32_t);
+}
@@ -0,0 +1,48 @@
+//
+// Index from normalized artist name to that artist's songs. The distinct
+// artist keys are sorted and every artist's song ids sit together in one
+// postings array in the same order, so all songs by artists starting with
+// a prefix are one contiguous slice of it.
+//
+
+#ifndef ARTISTINDEX_H
+#define ARTISTINDEX_H
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Songs.h"
+
+class ArtistIndex {
+public:
+    // replaces whatever was there with an index over songs, the ids are
+    // indexes into the same table the title indexes use
+    void build(const std::vector<Songs> &songs);
+
+    // appends the ids of songs whose artist starts with query, by artist then
+    // in table order, skipping offset of them and stopping after limit
+    void search(std::string_view query, std::vector<uint32_t> &results,
+                size_t limit = SIZE_MAX, size_t offset = 0) const;
+    // how many songs search() would return with no limit
+    size_t count(std::string_view query) const;
+
+    size_t artistCount() const { return artistStarts.empty() ? 0 : artistStarts.size() - 1; }
+    size_t memoryUsage() const;
+
+private:
+    // postings range of the artists starting with key
+    void range(std::string_view key, size_t &first, size_t &last) const;
+    size_t lowerBound(std::string_view key) const;
+
+    std::string_view keyAt(size_t artist) const {
+        return {keys.data() + keyOffsets[artist], keyOffsets[artist + 1] - keyOffsets[artist]};
+    }
+
+    std::string keys;                 // distinct artist keys, sorted, back to back
+    std::vector<uint32_t> keyOffsets; // artist a is keys[keyOffsets[a] .. keyOffsets[a + 1])
+    // artist a's songs are songIds[artistStarts[a] .. artistStarts[a + 1])
+    std::vector<uint32_t> artistStarts;
+    std::vector<uint32_t> songIds;
+};
+
+#endif //ARTISTINDEX_H
@@ -0,0 +1,34 @@
+//
+// Branchless binary search shared by the sorted array indexes
+//
+
+#ifndef BRANCHLESSSEARCH_H
+#define BRANCHLESSSEARCH_H
+#include <cstddef>
+
+// first index in [0, n) that below() is false for, or n. Khuong and Morin's
+// form: the range halves every step whatever the comparison says, and the
+// comparison only picks which half, so it compiles to a conditional move
+// rather than a branch the cpu has to guess. prefetch(i) is told about both
+// places the next step can look.
+template <typename Below, typename Prefetch>
+size_t branchlessLowerBound(size_t n, Below below, Prefetch prefetch) {
+    if (n == 0)
+        return 0;
+    size_t base = 0;
+    while (n > 1) {
+        size_t half = n / 2;
+        prefetch(base + half / 2);
+        prefetch(base + half + half / 2);
+        base = below(base + half) ? base + half : base;
+        n -= half;
+    }
+    return base + below(base);
+}
+
+template <typename Below>
+size_t branchlessLowerBound(size_t n, Below below) {
+    return branchlessLowerBound(n, below, [](size_t) {});
+}
+
+#endif //BRANCHLESSSEARCH_H
@@ -0,0 +1,27 @@
+//
+// FNV-1a over 8 byte words, the check the saved index files carry
+//
+
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+constexpr uint64_t checksumStart = 14695981039346656037ull;
+
+// fast enough to check a few hundred MB at startup. pieces of a multiple of
+// 8 bytes can be hashed one after another by passing the last result back in.
+inline uint64_t checksum(const char *data, size_t size, uint64_t hash = checksumStart) {
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, data + i, 8);
+        hash = (hash ^ word) * 1099511628211ull;
+    }
+    for (; i < size; ++i)
+        hash = (hash ^ static_cast<unsigned char>(data[i])) * 1099511628211ull;
+    return hash;
+}
+
+#endif //CHECKSUM_H
@@ -0,0 +1,234 @@
+//
+// Title index that any number of threads can search while one writer keeps
+// inserting and erasing. Readers take no locks: published nodes are never
+// changed, a write copies the path it touches and swaps in a new root, and
+// the old nodes are freed once no reader can still be looking at them.
+//
+
+#include "ConcurrentTitleIndex.h"
+#include "TitleKey.h"
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <thread>
+
+namespace {
+
+constexpr auto labelBelow = [](const auto &child, uint8_t label) { return child.label < label; };
+
+}
+
+// claims a reader slot and announces the epoch for the life of a search.
+// everything here is seq_cst: the announcement has to be visible before the
+// root is read, and the writer reads the slots only after the new root is out.
+class ConcurrentTitleIndex::ReadGuard {
+public:
+    explicit ReadGuard(const ConcurrentTitleIndex &index) {
+        // start at a per thread spot so threads rarely fight over a slot
+        thread_local size_t hint = std::hash<std::thread::id>()(std::this_thread::get_id());
+        for (size_t i = hint;; ++i) {
+            ReaderSlot &candidate = index.slots[i % readerSlots];
+            bool expected = false;
+            if (!candidate.taken.load(std::memory_order_relaxed)
+                && candidate.taken.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+                slot = &candidate;
+                hint = i;
+                break;
+            }
+            if (i - hint >= readerSlots)
+                std::this_thread::yield(); // more readers than slots, wait for one
+        }
+        slot->epoch.store(index.epoch.load());
+    }
+    ~ReadGuard() {
+        slot->epoch.store(0);
+        slot->taken.store(false, std::memory_order_release);
+    }
+    ReadGuard(const ReadGuard &) = delete;
+    ReadGuard &operator=(const ReadGuard &) = delete;
+
+private:
+    ReaderSlot *slot = nullptr;
+};
+
+ConcurrentTitleIndex::ConcurrentTitleIndex() : root(new Node {0, {}, {}}) {}
+
+ConcurrentTitleIndex::~ConcurrentTitleIndex() {
+    freeTree(root.load());
+    for (const Retired &old : retired)
+        delete old.node;
+}
+
+void ConcurrentTitleIndex::freeTree(Node *node) {
+    std::vector<Node *> stack {node};
+    while (!stack.empty()) {
+        Node *current = stack.back();
+        stack.pop_back();
+        for (const Child &child : current->children)
+            stack.push_back(child.node);
+        delete current;
+    }
+}
+
+void ConcurrentTitleIndex::insert(std::string_view songName, uint32_t songId) {
+    std::lock_guard lock(writeLock);
+    insertKey(titleKey(songName), songId);
+    publish();
+}
+
+bool ConcurrentTitleIndex::erase(std::string_view songName, uint32_t songId) {
+    std::lock_guard lock(writeLock);
+    bool erased = eraseKey(titleKey(songName), songId);
+    if (erased)
+        publish();
+    return erased;
+}
+
+void ConcurrentTitleIndex::insert(const std::vector<Songs> &songs, uint32_t first, uint32_t last, size_t batchSize) {
+    batchSize = std::max<size_t>(batchSize, 1);
+    while (first < last) {
+        // the lock is dropped between batches so single writes get a turn
+        std::lock_guard lock(writeLock);
+        uint32_t end = static_cast<uint32_t>(std::min<size_t>(last, first + batchSize));
+        for (; first < end; ++first)
+            insertKey(titleKey(songs[first].name), first);
+        publish();
+    }
+}
+
+// node itself if this write made it, else a private copy for this write to
+// change. within a batch a path is only copied the first time.
+ConcurrentTitleIndex::Node *ConcurrentTitleIndex::writable(const Node *node) {
+    if (node->version == writeVersion)
+        return const_cast<Node *>(node);
+    replaced.push_back(const_cast<Node *>(node));
+    return new Node {writeVersion, node->children, node->songs};
+}
+
+void ConcurrentTitleIndex::insertKey(std::string_view key, uint32_t songId) {
+    if (!workingRoot)
+        workingRoot = writable(root.load());
+    Node *node = workingRoot;
+    for (char c : key) {
+        auto label = static_cast<uint8_t>(c);
+        auto it = std::lower_bound(node->children.begin(), node->children.end(), label, labelBelow);
+        if (it == node->children.end() || it->label != label)
+            it = node->children.insert(it, {label, new Node {writeVersion, {}, {}}});
+        else
+            it->node = writable(it->node);
+        node = it->node;
+    }
+    node->songs.push_back(songId);
+}
+
+bool ConcurrentTitleIndex::eraseKey(std::string_view key, uint32_t songId) {
+    // look first so a miss copies nothing
+    const Node *current = workingRoot ? workingRoot : root.load();
+    for (char c : key) {
+        auto label = static_cast<uint8_t>(c);
+        auto it = std::lower_bound(current->children.begin(), current->children.end(), label, labelBelow);
+        if (it == current->children.end() || it->label != label)
+            return false;
+        current = it->node;
+    }
+    if (std::find(current->songs.begin(), current->songs.end(), songId) == current->songs.end())
+        return false;
+
+    if (!workingRoot)
+        workingRoot = writable(root.load());
+    std::vector<Node *> path {workingRoot};
+    std::vector<size_t> childAt;
+    for (char c : key) {
+        Node *node = path.back();
+        auto label = static_cast<uint8_t>(c);
+        size_t i = 0;
+        while (node->children[i].label != label)
+            ++i;
+        node->children[i].node = writable(node->children[i].node);
+        path.push_back(node->children[i].node);
+        childAt.push_back(i);
+    }
+    std::vector<uint32_t> &songs = path.back()->songs;
+    songs.erase(std::find(songs.begin(), songs.end(), songId));
+
+    // drop the chain of nodes that now lead nowhere, the root always stays.
+    // they are this write's copies, nobody else has seen them.
+    while (path.size() > 1 && path.back()->songs.empty() && path.back()->children.empty()) {
+        delete path.back();
+        path.pop_back();
+        path.back()->children.erase(path.back()->children.begin() + childAt.back());
+        childAt.pop_back();
+    }
+    return true;
+}
+
+// swaps in the new root, then retires what it replaced under the epoch that
+// was current before the swap. a reader that can see those nodes announced
+// that epoch or an older one.
+void ConcurrentTitleIndex::publish() {
+    if (!workingRoot)
+        return;
+    root.store(workingRoot);
+    uint64_t retiredIn = epoch.fetch_add(1);
+    for (Node *node : replaced)
+        retired.push_back({node, retiredIn});
+    replaced.clear();
+    workingRoot = nullptr;
+    ++writeVersion;
+    reclaim();
+}
+
+// frees every retired node older than the oldest epoch a reader announced
+void ConcurrentTitleIndex::reclaim() {
+    uint64_t oldest = UINT64_MAX;
+    for (const ReaderSlot &slot : slots) {
+        uint64_t seen = slot.epoch.load();
+        if (seen)
+            oldest = std::min(oldest, seen);
+    }
+    auto stillSeen = std::partition(retired.begin(), retired.end(),
+                                    [oldest](const Retired &old) { return old.epoch >= oldest; });
+    for (auto it = stillSeen; it != retired.end(); ++it)
+        delete it->node;
+    retired.erase(stillSeen, retired.end());
+}
+
+size_t ConcurrentTitleIndex::retiredCount() const {
+    std::lock_guard lock(writeLock);
+    return retired.size();
+}
+
+void ConcurrentTitleIndex::search(std::string_view query, std::vector<uint32_t> &results, size_t limit,
+                                  size_t offset) const {
+    if (limit == 0)
+        return;
+    std::string key = titleKey(query);
+    ReadGuard guard(*this);
+    const Node *node = root.load();
+    for (char c : key) {
+        auto label = static_cast<uint8_t>(c);
+        auto it = std::lower_bound(node->children.begin(), node->children.end(), label, labelBelow);
+        if (it == node->children.end() || it->label != label)
+            return;
+        node = it->node;
+    }
+
+    // preorder, children pushed in reverse so the smallest label comes off first
+    size_t added = 0;
+    std::vector<const Node *> stack {node};
+    while (!stack.empty()) {
+        const Node *current = stack.back();
+        stack.pop_back();
+        for (uint32_t songId : current->songs) {
+            if (offset) {
+                --offset;
+                continue;
+            }
+            results.push_back(songId);
+            if (++added == limit)
+                return;
+        }
+        for (auto it = current->children.rbegin(); it != current->children.rend(); ++it)
+            stack.push_back(it->node);
+    }
+}
@@ -0,0 +1,88 @@
+//
+// Title index that any number of threads can search while one writer keeps
+// inserting and erasing. Readers take no locks: published nodes are never
+// changed, a write copies the path it touches and swaps in a new root, and
+// the old nodes are freed once no reader can still be looking at them.
+//
+
+#ifndef CONCURRENTTITLEINDEX_H
+#define CONCURRENTTITLEINDEX_H
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string_view>
+#include <vector>
+#include "Songs.h"
+
+class ConcurrentTitleIndex {
+public:
+    ConcurrentTitleIndex();
+    // no reader or writer may still be running
+    ~ConcurrentTitleIndex();
+    ConcurrentTitleIndex(const ConcurrentTitleIndex &) = delete;
+    ConcurrentTitleIndex &operator=(const ConcurrentTitleIndex &) = delete;
+
+    // writers are serialized, each call is visible to searches that start
+    // after it returns
+    void insert(std::string_view songName, uint32_t songId);
+    // false if that song is not filed under that title
+    bool erase(std::string_view songName, uint32_t songId);
+    // adds songs [first, last) of the table, publishing every batchSize of
+    // them so searches see the import progress and old paths get freed
+    void insert(const std::vector<Songs> &songs, uint32_t first, uint32_t last, size_t batchSize = 4096);
+
+    // safe from any thread at any time. appends the ids of songs whose title
+    // starts with query, in the same order as Trie::search
+    void search(std::string_view query, std::vector<uint32_t> &results,
+                size_t limit = SIZE_MAX, size_t offset = 0) const;
+
+    // nodes replaced by writes that readers may still hold
+    size_t retiredCount() const;
+
+private:
+    struct Node;
+    struct Child {
+        uint8_t label;
+        Node *node;
+    };
+    struct Node {
+        uint64_t version; // the write that made it, it is only changed by that write
+        std::vector<Child> children; // sorted by label
+        std::vector<uint32_t> songs;
+    };
+
+    // one per concurrent reader. epoch is 0 while the slot is idle, else the
+    // epoch the reader saw before it loaded the root
+    struct alignas(64) ReaderSlot {
+        std::atomic<bool> taken {false};
+        std::atomic<uint64_t> epoch {0};
+    };
+    static constexpr size_t readerSlots = 64;
+
+    class ReadGuard;
+
+    struct Retired {
+        Node *node;
+        uint64_t epoch;
+    };
+
+    // writer side, writeLock held
+    Node *writable(const Node *node);
+    void insertKey(std::string_view key, uint32_t songId);
+    bool eraseKey(std::string_view key, uint32_t songId);
+    void publish();
+    void reclaim();
+    static void freeTree(Node *node);
+
+    std::atomic<Node *> root;
+    mutable ReaderSlot slots[readerSlots];
+    std::atomic<uint64_t> epoch {1};
+
+    mutable std::mutex writeLock;
+    uint64_t writeVersion = 1;  // nodes with this version are not published yet
+    Node *workingRoot = nullptr; // the next root while a write is under way
+    std::vector<Node *> replaced; // published nodes the current write copied
+    std::vector<Retired> retired;
+};
+
+#endif //CONCURRENTTITLEINDEX_H
@@ -0,0 +1,170 @@
+//
+// Streaming, quote-aware csv reader (RFC 4180) for the song catalog
+//
+
+#include "CsvParser.h"
+#include <bit>
+#include <cstring>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+constexpr size_t blockSize = 64;
+
+struct BlockMasks {
+    uint64_t quote;
+    uint64_t comma;
+    uint64_t newline;
+};
+
+// one bit per byte of the 64 byte block for each character we care about
+BlockMasks scanBlock(const char* p) {
+#if defined(__AVX2__)
+    auto lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    auto hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32));
+    auto mask = [&](char c) {
+        auto needle = _mm256_set1_epi8(c);
+        uint64_t low = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, needle)));
+        uint64_t high = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, needle)));
+        return low | (high << 32);
+    };
+    return {mask('"'), mask(','), mask('\n')};
+#elif defined(__SSE2__)
+    __m128i chunk[4];
+    for (int i = 0; i < 4; ++i)
+        chunk[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16 * i));
+    auto mask = [&](char c) {
+        auto needle = _mm_set1_epi8(c);
+        uint64_t bits = 0;
+        for (int i = 0; i < 4; ++i) {
+            auto hit = static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk[i], needle)));
+            bits |= static_cast<uint64_t>(hit) << (16 * i);
+        }
+        return bits;
+    };
+    return {mask('"'), mask(','), mask('\n')};
+#else
+    BlockMasks masks {0, 0, 0};
+    for (size_t i = 0; i < blockSize; ++i) {
+        uint64_t bit = uint64_t(1) << i;
+        if (p[i] == '"') masks.quote |= bit;
+        else if (p[i] == ',') masks.comma |= bit;
+        else if (p[i] == '\n') masks.newline |= bit;
+    }
+    return masks;
+#endif
+}
+
+// bit i of the result is the xor of bits 0..i, i.e. "inside quotes" at byte i
+uint64_t prefixXor(uint64_t bits) {
+#if defined(__PCLMUL__)
+    auto product = _mm_clmulepi64_si128(_mm_set_epi64x(0, static_cast<long long>(bits)),
+                                        _mm_set1_epi8(static_cast<char>(0xFF)), 0);
+    return static_cast<uint64_t>(_mm_cvtsi128_si64(product));
+#else
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+    return bits;
+#endif
+}
+
+}
+
+CsvParser::CsvParser(char* begin, char* end)
+    : end(end), nextBlock(begin), blockStart(begin), fieldStart(begin) {
+}
+
+bool CsvParser::loadNextBlock() {
+    if (nextBlock >= end)
+        return false;
+
+    blockStart = nextBlock;
+    BlockMasks masks {};
+    size_t left = static_cast<size_t>(end - blockStart);
+    if (left >= blockSize) {
+        masks = scanBlock(blockStart);
+        nextBlock = blockStart + blockSize;
+    } else {
+        // last partial block, pad with zeros so nothing past end can match
+        char tail[blockSize] = {};
+        std::memcpy(tail, blockStart, left);
+        masks = scanBlock(tail);
+        nextBlock = end;
+    }
+
+    uint64_t quoted = prefixXor(masks.quote) ^ inQuote;
+    // carry the quote state of the last byte into the next block
+    inQuote = static_cast<uint64_t>(static_cast<int64_t>(quoted) >> 63);
+    structural = (masks.comma | masks.newline) & ~quoted;
+    return true;
+}
+
+std::string_view CsvParser::finishField(char* start, char* stop) const {
+    // tolerate windows line endings
+    if (stop > start && stop[-1] == '\r')
+        --stop;
+    if (stop == start || *start != '"')
+        return {start, static_cast<size_t>(stop - start)};
+
+    // drop the outer quotes, anything after the closing quote is ignored
+    char* content = start + 1;
+    char* close = stop;
+    while (close > content && close[-1] != '"')
+        --close;
+    char* contentEnd = close > content ? close - 1 : stop;
+
+    // collapse "" to " by shifting the rest of the field down
+    char* out = static_cast<char*>(std::memchr(content, '"', contentEnd - content));
+    if (!out)
+        return {content, static_cast<size_t>(contentEnd - content)};
+    char* in = out;
+    while (in < contentEnd) {
+        char c = *in++;
+        if (c == '"' && in < contentEnd && *in == '"')
+            ++in;
+        *out++ = c;
+    }
+    return {content, static_cast<size_t>(out - content)};
+}
+
+const char* CsvParser::nextRecordStart(const char* from, const char* end, bool inQuote) {
+    for (const char* p = from; p < end; ++p) {
+        if (*p == '"')
+            inQuote = !inQuote;
+        else if (*p == '\n' && !inQuote)
+            return p + 1;
+    }
+    return end;
+}
+
+bool CsvParser::nextRecord(std::vector<std::string_view>& fields) {
+    fields.clear();
+    if (fieldStart >= end)
+        return false;
+
+    while (true) {
+        while (structural == 0) {
+            if (!loadNextBlock()) {
+                // input ended without a final newline
+                fields.push_back(finishField(fieldStart, end));
+                fieldStart = end;
+                return true;
+            }
+        }
+
+        char* separator = blockStart + std::countr_zero(structural);
+        structural &= structural - 1;
+
+        fields.push_back(finishField(fieldStart, separator));
+        fieldStart = separator + 1;
+        if (*separator == '\n')
+            return true;
+    }
+}
@@ -0,0 +1,44 @@
+//
+// Streaming, quote-aware csv reader (RFC 4180) for the song catalog
+//
+
+#ifndef CSVPARSER_H
+#define CSVPARSER_H
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+
+// Walks a csv buffer one record at a time. Quotes, commas and newlines are
+// found 64 bytes at a time with SIMD compares, and which of them are inside a
+// quoted field is worked out with a prefix xor over the quote bits (same idea
+// as simdcsv), so embedded commas and newlines never split a record.
+//
+// Quoted fields come back without their outer quotes and with "" collapsed
+// to ", which is done in place. The buffer therefore has to be writable and
+// every returned view points into it.
+class CsvParser {
+    public:
+    CsvParser(char* begin, char* end);
+
+    // fills fields with the next record, returns false once the input is used up
+    bool nextRecord(std::vector<std::string_view>& fields);
+
+    // first byte after the next newline that is outside quotes, or end.
+    // inQuote says whether from itself sits inside a quoted field.
+    static const char* nextRecordStart(const char* from, const char* end, bool inQuote);
+
+    private:
+    bool loadNextBlock();
+    std::string_view finishField(char* start, char* stop) const;
+
+    char* end;
+    char* nextBlock;        // first byte not scanned yet
+    char* blockStart;       // first byte of the block structural belongs to
+    char* fieldStart;       // first byte of the field being read
+    uint64_t structural = 0; // unquoted commas/newlines left in the current block
+    uint64_t inQuote = 0;    // all ones if the previous block ended inside quotes
+};
+
+#endif //CSVPARSER_H
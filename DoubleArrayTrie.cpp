@@ -0,0 +1,329 @@
+//
+// Static double-array trie over song titles. Built once from the song
+// table, then every step of a search is two array reads (BASE and CHECK),
+// and the whole index is a few flat arrays that can be saved and mmapped.
+//
+
+#include "DoubleArrayTrie.h"
+#include "Checksum.h"
+#include "TitleKey.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+
+namespace {
+
+constexpr char datMagic[8] = {'S', 'O', 'N', 'G', 'D', 'A', 'T', '3'};
+constexpr int32_t freeSlot = -1;
+
+struct DatHeader {
+    char magic[8];
+    uint64_t size;
+    uint64_t keyCount;
+    uint64_t songCount;
+    uint64_t checksum; // of the arrays after the header
+};
+
+using ArrayBytes = std::array<std::string_view, 6>;
+
+// the arrays in file order, as bytes
+ArrayBytes arrayBytes(const int32_t *base, const int32_t *check, const uint32_t *firstKeys,
+                      const uint32_t *keyCounts, const uint32_t *keyStarts, const uint32_t *songIds,
+                      uint64_t size, uint64_t keyCount, uint64_t songCount) {
+    auto bytes = [](const auto *array, uint64_t count) {
+        return std::string_view(reinterpret_cast<const char *>(array), count * sizeof(*array));
+    };
+    return {bytes(base, size), bytes(check, size), bytes(firstKeys, size), bytes(keyCounts, size),
+            bytes(keyStarts, keyCount + 1), bytes(songIds, songCount)};
+}
+
+// each array is hashed on its own and the results chained, so the arrays
+// don't have to be whole 8 byte words or sit next to each other
+uint64_t arraysChecksum(const ArrayBytes &arrays) {
+    uint64_t hash = checksumStart;
+    for (std::string_view array : arrays)
+        hash = checksum(array.data(), array.size(), hash);
+    return hash;
+}
+
+uint32_t codeAt(const std::string &key, size_t depth) {
+    return depth < key.size() ? static_cast<unsigned char>(key[depth]) + 1u : 0u;
+}
+
+}
+
+void DoubleArrayTrie::point() {
+    base = ownedBase.data();
+    check = ownedCheck.data();
+    firstKeys = ownedFirstKeys.data();
+    keyCounts = ownedKeyCounts.data();
+    keyStarts = ownedKeyStarts.data();
+    songIds = ownedSongIds.data();
+    size = ownedBase.size();
+}
+
+void DoubleArrayTrie::build(const std::vector<Songs> &songs) {
+    mapping = MappedFile();
+
+    // group the songs by key, in key order, keeping table order within a key
+    std::vector<std::string> keyOf(songs.size());
+    for (size_t i = 0; i < songs.size(); ++i)
+        keyOf[i] = titleKey(songs[i].name);
+    std::vector<uint32_t> order(songs.size());
+    std::iota(order.begin(), order.end(), 0u);
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return keyOf[a] < keyOf[b]; });
+
+    std::vector<std::string> keys;
+    ownedKeyStarts.clear();
+    ownedSongIds = order;
+    for (uint32_t i = 0; i < order.size(); ++i) {
+        if (keys.empty() || keys.back() != keyOf[order[i]]) {
+            keys.push_back(keyOf[order[i]]);
+            ownedKeyStarts.push_back(i);
+        }
+    }
+    ownedKeyStarts.push_back(static_cast<uint32_t>(order.size()));
+    keyOf.clear();
+    keyOf.shrink_to_fit();
+
+    ownedBase.assign(1024, 0);
+    ownedCheck.assign(1024, freeSlot);
+    ownedCheck[0] = 0; // root
+    ownedFirstKeys.assign(1024, 0);
+    ownedKeyCounts.assign(1024, 0);
+    std::vector<bool> baseUsed(1024, false);
+    size_t nextCheckPos = 1;
+
+    auto grow = [&](size_t needed) {
+        if (needed <= ownedBase.size())
+            return;
+        size_t bigger = std::max(needed, ownedBase.size() * 2);
+        ownedBase.resize(bigger, 0);
+        ownedCheck.resize(bigger, freeSlot);
+        ownedFirstKeys.resize(bigger, 0);
+        ownedKeyCounts.resize(bigger, 0);
+        baseUsed.resize(bigger, false);
+    };
+
+    // each pending state covers the sorted keys [first, last) that share the
+    // first depth bytes, so its children are the distinct bytes at depth
+    struct Pending {
+        int32_t state;
+        uint32_t first;
+        uint32_t last;
+        uint32_t depth;
+    };
+    std::deque<Pending> pending;
+    if (!keys.empty())
+        pending.push_back({0, 0, static_cast<uint32_t>(keys.size()), 0});
+
+    std::vector<uint32_t> codes;
+    std::vector<uint32_t> childFirst;
+    while (!pending.empty()) {
+        Pending node = pending.front();
+        pending.pop_front();
+        ownedFirstKeys[node.state] = node.first;
+        ownedKeyCounts[node.state] = node.last - node.first;
+
+        codes.clear();
+        childFirst.clear();
+        for (uint32_t k = node.first; k < node.last; ++k) {
+            uint32_t code = codeAt(keys[k], node.depth);
+            if (codes.empty() || codes.back() != code) {
+                codes.push_back(code);
+                childFirst.push_back(k);
+            }
+        }
+        childFirst.push_back(node.last);
+
+        // lowest base where every child slot is free, starting the scan past
+        // the part of the array that is already (nearly) full
+        size_t position = std::max<size_t>(nextCheckPos, codes[0] + 1);
+        size_t scanned = 0;
+        size_t occupied = 0;
+        int32_t chosen = 0;
+        while (true) {
+            grow(position + 1);
+            if (ownedCheck[position] != freeSlot) {
+                ++occupied;
+                ++position;
+                ++scanned;
+                continue;
+            }
+            size_t candidate = position - codes[0];
+            grow(candidate + codes.back() + 1);
+            bool fits = !baseUsed[candidate];
+            for (size_t i = 1; fits && i < codes.size(); ++i)
+                fits = ownedCheck[candidate + codes[i]] == freeSlot;
+            if (fits) {
+                chosen = static_cast<int32_t>(candidate);
+                break;
+            }
+            ++position;
+            ++scanned;
+        }
+        if (scanned && static_cast<double>(occupied) / static_cast<double>(scanned) >= 0.95)
+            nextCheckPos = position;
+
+        baseUsed[chosen] = true;
+        ownedBase[node.state] = chosen;
+        for (size_t i = 0; i < codes.size(); ++i)
+            ownedCheck[chosen + codes[i]] = node.state;
+
+        for (size_t i = 0; i < codes.size(); ++i) {
+            int32_t child = chosen + static_cast<int32_t>(codes[i]);
+            if (codes[i] == endCode) {
+                ownedBase[child] = -static_cast<int32_t>(childFirst[i]) - 1; // key number childFirst[i]
+                ownedFirstKeys[child] = childFirst[i];
+                ownedKeyCounts[child] = 1;
+            } else
+                pending.push_back({child, childFirst[i], childFirst[i + 1], node.depth + 1});
+        }
+    }
+
+    // drop the unused tail, every transition target is below the last used slot
+    size_t used = ownedCheck.size();
+    while (used > 1 && ownedCheck[used - 1] == freeSlot)
+        --used;
+    ownedBase.resize(used);
+    ownedCheck.resize(used);
+    ownedFirstKeys.resize(used);
+    ownedKeyCounts.resize(used);
+    ownedBase.shrink_to_fit();
+    ownedCheck.shrink_to_fit();
+    ownedFirstKeys.shrink_to_fit();
+    ownedKeyCounts.shrink_to_fit();
+
+    keyCount = keys.size();
+    songCount = ownedSongIds.size();
+    point();
+}
+
+// state the key leads to, or -1 as unsigned if it falls off the trie
+uint32_t DoubleArrayTrie::walk(std::string_view key) const {
+    if (size == 0)
+        return UINT32_MAX;
+    uint32_t state = 0;
+    for (char c : key) {
+        if (base[state] < 0)
+            return UINT32_MAX;
+        uint64_t next = static_cast<uint64_t>(base[state]) + static_cast<unsigned char>(c) + 1;
+        if (next >= size || check[next] != static_cast<int32_t>(state))
+            return UINT32_MAX;
+        state = static_cast<uint32_t>(next);
+    }
+    return state;
+}
+
+// the keys below a state are one run of the sorted keys, and their songs
+// one run of songIds, so no part of the trie below it is walked
+bool DoubleArrayTrie::songRange(std::string_view query, uint32_t &first, uint32_t &last) const {
+    uint32_t state = walk(titleKey(query));
+    if (state == UINT32_MAX || keyCounts[state] == 0)
+        return false;
+    first = keyStarts[firstKeys[state]];
+    last = keyStarts[firstKeys[state] + keyCounts[state]];
+    return true;
+}
+
+void DoubleArrayTrie::search(std::string_view query, std::vector<uint32_t> &results, size_t limit, size_t offset) const {
+    uint32_t first;
+    uint32_t last;
+    if (!songRange(query, first, last) || offset >= last - first)
+        return;
+    first += static_cast<uint32_t>(offset);
+    size_t end = first + std::min<size_t>(limit, last - first);
+    results.insert(results.end(), songIds + first, songIds + end);
+}
+
+size_t DoubleArrayTrie::count(std::string_view query) const {
+    uint32_t first;
+    uint32_t last;
+    return songRange(query, first, last) ? last - first : 0;
+}
+
+size_t DoubleArrayTrie::memoryUsage() const {
+    return size * 4 * sizeof(uint32_t) + (size ? keyCount + 1 : 0) * sizeof(uint32_t) + songCount * sizeof(uint32_t);
+}
+
+bool DoubleArrayTrie::save(const std::string &fileName) const {
+    std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        std::cerr << "Error opening file " << fileName << std::endl;
+        return false;
+    }
+    DatHeader header {};
+    std::memcpy(header.magic, datMagic, sizeof(header.magic));
+    header.size = size;
+    header.keyCount = keyCount;
+    header.songCount = songCount;
+    ArrayBytes arrays = arrayBytes(base, check, firstKeys, keyCounts, keyStarts, songIds, size, keyCount, songCount);
+    header.checksum = arraysChecksum(arrays);
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    for (std::string_view array : arrays)
+        file.write(array.data(), static_cast<std::streamsize>(array.size()));
+    return static_cast<bool>(file);
+}
+
+bool DoubleArrayTrie::load(const std::string &fileName) {
+    MappedFile file(fileName, MappedFile::Access::Random);
+    if (!file.isOpen() || file.size() < sizeof(DatHeader))
+        return false;
+    DatHeader header {};
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, datMagic, sizeof(header.magic)) != 0)
+        return false;
+    // every count is a uint32_t index, so the sums below can't overflow
+    if (header.size == 0 || header.size > UINT32_MAX || header.keyCount >= UINT32_MAX || header.songCount > UINT32_MAX)
+        return false;
+    uint64_t expected = sizeof(header) + header.size * 16 + (header.keyCount + 1) * 4 + header.songCount * 4;
+    if (expected != file.size())
+        return false;
+
+    auto loadedBase = reinterpret_cast<const int32_t *>(file.data() + sizeof(header));
+    const int32_t *loadedCheck = loadedBase + header.size;
+    auto loadedFirstKeys = reinterpret_cast<const uint32_t *>(loadedCheck + header.size);
+    const uint32_t *loadedKeyCounts = loadedFirstKeys + header.size;
+    const uint32_t *loadedKeyStarts = loadedKeyCounts + header.size;
+    const uint32_t *loadedSongIds = loadedKeyStarts + header.keyCount + 1;
+    if (arraysChecksum(arrayBytes(loadedBase, loadedCheck, loadedFirstKeys, loadedKeyCounts, loadedKeyStarts,
+                                  loadedSongIds, header.size, header.keyCount, header.songCount))
+        != header.checksum) {
+        std::cerr << "Index " << fileName << " is corrupt, ignoring it" << std::endl;
+        return false;
+    }
+    // searches index straight through these, so they have to stay in range
+    // even for a file that was written wrong rather than damaged
+    for (uint64_t state = 0; state < header.size; ++state) {
+        if (loadedFirstKeys[state] > header.keyCount || loadedKeyCounts[state] > header.keyCount - loadedFirstKeys[state])
+            return false;
+    }
+    for (uint64_t key = 0; key < header.keyCount; ++key) {
+        if (loadedKeyStarts[key] > loadedKeyStarts[key + 1])
+            return false;
+    }
+    if (loadedKeyStarts[header.keyCount] > header.songCount)
+        return false;
+
+    ownedBase.clear();
+    ownedCheck.clear();
+    ownedFirstKeys.clear();
+    ownedKeyCounts.clear();
+    ownedKeyStarts.clear();
+    ownedSongIds.clear();
+    size = header.size;
+    keyCount = header.keyCount;
+    songCount = header.songCount;
+    base = loadedBase;
+    check = loadedCheck;
+    firstKeys = loadedFirstKeys;
+    keyCounts = loadedKeyCounts;
+    keyStarts = loadedKeyStarts;
+    songIds = loadedSongIds;
+    mapping = std::move(file);
+    return true;
+}
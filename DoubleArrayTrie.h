@@ -0,0 +1,71 @@
+//
+// Static double-array trie over song titles. Built once from the song
+// table, then every step of a search is two array reads (BASE and CHECK),
+// and the whole index is a few flat arrays that can be saved and mmapped.
+//
+
+#ifndef DOUBLEARRAYTRIE_H
+#define DOUBLEARRAYTRIE_H
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "MappedFile.h"
+#include "Songs.h"
+
+class DoubleArrayTrie {
+public:
+    // replaces whatever was there with an index over songs
+    void build(const std::vector<Songs> &songs);
+
+    // same as Trie::search: ids of songs whose title starts with query, in the
+    // same order, skipping offset matches and stopping after limit
+    void search(std::string_view query, std::vector<uint32_t> &results,
+                size_t limit = SIZE_MAX, size_t offset = 0) const;
+
+    // how many songs search() would return with no limit
+    size_t count(std::string_view query) const;
+
+    size_t arraySize() const { return size; }
+    // bytes of the arrays, whether built or mapped
+    size_t memoryUsage() const;
+
+    bool save(const std::string &fileName) const;
+    // maps fileName and answers queries straight out of the mapping
+    bool load(const std::string &fileName);
+
+private:
+    // the transition for a key byte b is code b + 1, code 0 marks end of key
+    static constexpr uint32_t endCode = 0;
+
+    uint32_t walk(std::string_view key) const;
+    // the songs under the state query leads to are songIds[first, last),
+    // false if there are none
+    bool songRange(std::string_view query, uint32_t &first, uint32_t &last) const;
+    void point();
+
+    // owned arrays after build(), empty after load()
+    std::vector<int32_t> ownedBase;
+    std::vector<int32_t> ownedCheck;
+    std::vector<uint32_t> ownedFirstKeys;
+    std::vector<uint32_t> ownedKeyCounts;
+    std::vector<uint32_t> ownedKeyStarts;
+    std::vector<uint32_t> ownedSongIds;
+    MappedFile mapping;
+
+    // base[s] + code is the next state, valid when check of it is s. a leaf
+    // has base -(key number + 1). the keys are numbered in sorted order, so
+    // the ones below s are the keyCounts[s] from firstKeys[s] on, and key k's
+    // songs are songIds[keyStarts[k] .. keyStarts[k + 1])
+    const int32_t *base = nullptr;
+    const int32_t *check = nullptr;
+    const uint32_t *firstKeys = nullptr;
+    const uint32_t *keyCounts = nullptr;
+    const uint32_t *keyStarts = nullptr;
+    const uint32_t *songIds = nullptr;
+    size_t size = 0;
+    size_t keyCount = 0;
+    size_t songCount = 0;
+};
+
+#endif //DOUBLEARRAYTRIE_H
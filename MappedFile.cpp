@@ -0,0 +1,68 @@
+//
+// Private mapping of a whole file, used so songs can point straight into it
+//
+
+#include "MappedFile.h"
+#include <iostream>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const std::string& fileName, Access access) {
+    int fd = open(fileName.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Error opening file " << fileName << std::endl;
+        return;
+    }
+
+    struct stat info {};
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        // nothing to map, an empty file just loads no songs
+        close(fd);
+        return;
+    }
+
+    // copy-on-write, so the csv parser can unescape quoted fields in place
+    void* mapped = mmap(nullptr, info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    // the mapping keeps its own reference to the file
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        std::cerr << "Error mapping file " << fileName << std::endl;
+        return;
+    }
+
+    // sequential reads ahead aggressively and drops pages behind, which only
+    // suits a single pass. random turns read ahead off for the index files.
+    if (access == Access::Sequential)
+        madvise(mapped, info.st_size, MADV_SEQUENTIAL);
+    else if (access == Access::Random)
+        madvise(mapped, info.st_size, MADV_RANDOM);
+    bytes = static_cast<char*>(mapped);
+    length = static_cast<size_t>(info.st_size);
+}
+
+MappedFile::~MappedFile() {
+    unmap();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : bytes(std::exchange(other.bytes, nullptr)), length(std::exchange(other.length, 0)) {
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        unmap();
+        bytes = std::exchange(other.bytes, nullptr);
+        length = std::exchange(other.length, 0);
+    }
+    return *this;
+}
+
+void MappedFile::unmap() {
+    if (bytes)
+        munmap(bytes, length);
+    bytes = nullptr;
+    length = 0;
+}
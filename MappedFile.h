@@ -0,0 +1,45 @@
+//
+// Private mapping of a whole file, used so songs can point straight into it
+//
+
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+
+class MappedFile {
+    public:
+    // how the mapping is going to be read, passed on to the kernel so it
+    // reads ahead only where that pays off
+    enum class Access {
+        Sequential, // front to back once, like the csv loader
+        Random,     // lookups all over the file, like the index files
+        Normal      // neither, the kernel's default read ahead
+    };
+
+    MappedFile() = default;
+    MappedFile(const std::string& fileName, Access access);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    bool isOpen() const { return bytes != nullptr; }
+    const char* data() const { return bytes; }
+    // writes only touch our private copy of the page, never the file itself
+    char* data() { return bytes; }
+    size_t size() const { return length; }
+    std::string_view view() const { return {bytes, length}; }
+
+    private:
+    void unmap();
+
+    char* bytes = nullptr;
+    size_t length = 0;
+};
+
+#endif //MAPPEDFILE_H
@@ -0,0 +1,27 @@
+//
+// Small threading helpers shared by the loader and the index builders
+//
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+// how many threads to use when the caller passed 0
+inline unsigned defaultThreadCount() {
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// runs work(i) for every i in [0, count) on its own thread
+template <typename Work>
+void runOnThreads(unsigned count, Work work) {
+    std::vector<std::thread> threads;
+    threads.reserve(count);
+    for (unsigned i = 0; i < count; ++i)
+        threads.emplace_back(work, i);
+    for (auto& thread : threads)
+        thread.join();
+}
+
+#endif //PARALLEL_H
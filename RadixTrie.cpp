@@ -0,0 +1,170 @@
+//
+// Path compressed (radix / Patricia) trie over song titles. Same
+// insert/search as Trie, but a chain of single child nodes is one edge.
+//
+
+#include "RadixTrie.h"
+#include "TitleKey.h"
+#include <algorithm>
+
+RadixTrie::RadixTrie() {
+    nodes.emplace_back(); // root, empty label
+}
+
+uint32_t RadixTrie::findChild(uint32_t node, char first) const {
+    for (uint32_t child = nodes[node].firstChild; child != none; child = nodes[child].nextSibling) {
+        char c = labelPool[nodes[child].labelOffset];
+        if (c == first)
+            return child;
+        if (static_cast<unsigned char>(c) > static_cast<unsigned char>(first))
+            break;
+    }
+    return none;
+}
+
+// new leaf under parent labelled with the rest of the key, kept in sorted position
+uint32_t RadixTrie::addChild(uint32_t parent, std::string_view key) {
+    RadixNode leaf;
+    leaf.labelOffset = static_cast<uint32_t>(labelPool.size());
+    leaf.labelLength = static_cast<uint32_t>(key.size());
+    labelPool += key;
+
+    uint32_t index = static_cast<uint32_t>(nodes.size());
+    auto first = static_cast<unsigned char>(key[0]);
+    uint32_t *link = &nodes[parent].firstChild;
+    while (*link != none && static_cast<unsigned char>(labelPool[nodes[*link].labelOffset]) < first)
+        link = &nodes[*link].nextSibling;
+    leaf.nextSibling = *link;
+
+    // link points into nodes, so set it before the push can move the vector
+    *link = index;
+    nodes.push_back(leaf);
+    return index;
+}
+
+void RadixTrie::addSong(uint32_t node, uint32_t songId) {
+    uint32_t entry = static_cast<uint32_t>(songEntries.size());
+    songEntries.push_back({songId, none});
+    if (nodes[node].firstSong == none)
+        nodes[node].firstSong = entry;
+    else
+        songEntries[nodes[node].lastSong].next = entry;
+    nodes[node].lastSong = entry;
+}
+
+void RadixTrie::insert(std::string_view songName, uint32_t songId) {
+    std::string key = titleKey(songName);
+    std::string_view rest = key;
+    uint32_t node = 0;
+
+    while (!rest.empty()) {
+        uint32_t child = findChild(node, rest[0]);
+        if (child == none) {
+            node = addChild(node, rest);
+            rest = {};
+            break;
+        }
+
+        std::string_view edge = label(nodes[child]);
+        size_t common = std::mismatch(edge.begin(), edge.end(), rest.begin(), rest.end()).first - edge.begin();
+        if (common < edge.size()) {
+            // split the edge: child keeps the tail, a new middle node takes the head
+            RadixNode middle;
+            middle.labelOffset = nodes[child].labelOffset;
+            middle.labelLength = static_cast<uint32_t>(common);
+            middle.firstChild = child;
+            middle.nextSibling = nodes[child].nextSibling;
+
+            uint32_t middleIndex = static_cast<uint32_t>(nodes.size());
+            nodes[child].labelOffset += static_cast<uint32_t>(common);
+            nodes[child].labelLength -= static_cast<uint32_t>(common);
+            nodes[child].nextSibling = none;
+
+            uint32_t *link = &nodes[node].firstChild;
+            while (*link != child)
+                link = &nodes[*link].nextSibling;
+            *link = middleIndex;
+            nodes.push_back(middle);
+            child = middleIndex;
+        }
+        node = child;
+        rest.remove_prefix(common);
+    }
+    addSong(node, songId);
+}
+
+uint32_t RadixTrie::findNode(std::string_view query) const {
+    std::string key = titleKey(query);
+    std::string_view rest = key;
+    uint32_t node = 0;
+
+    while (!rest.empty()) {
+        uint32_t child = findChild(node, rest[0]);
+        if (child == none)
+            return none;
+        std::string_view edge = label(nodes[child]);
+        size_t common = std::min(edge.size(), rest.size());
+        if (edge.compare(0, common, rest, 0, common) != 0)
+            return none;
+        // a query that stops inside an edge still matches everything below it
+        node = child;
+        rest.remove_prefix(common);
+    }
+    return node;
+}
+
+void RadixTrie::search(std::string_view query, std::vector<uint32_t> &results, size_t limit, size_t offset) const {
+    uint32_t node = findNode(query);
+    if (node != none)
+        collectSongs(node, results, limit, offset);
+}
+
+size_t RadixTrie::count(std::string_view query) const {
+    uint32_t node = findNode(query);
+    if (node == none)
+        return 0;
+    size_t songs = 0;
+    std::vector<uint32_t> stack {node};
+    while (!stack.empty()) {
+        uint32_t current = stack.back();
+        stack.pop_back();
+        for (uint32_t entry = nodes[current].firstSong; entry != none; entry = songEntries[entry].next)
+            ++songs;
+        if (current != node && nodes[current].nextSibling != none)
+            stack.push_back(nodes[current].nextSibling);
+        if (nodes[current].firstChild != none)
+            stack.push_back(nodes[current].firstChild);
+    }
+    return songs;
+}
+
+size_t RadixTrie::memoryUsage() const {
+    return nodes.capacity() * sizeof(RadixNode) + songEntries.capacity() * sizeof(SongEntry) + labelPool.capacity();
+}
+
+// preorder with an explicit stack: after a node come its children, then its
+// next sibling, so pushing (sibling, first child) keeps the sorted order
+void RadixTrie::collectSongs(uint32_t node, std::vector<uint32_t> &results, size_t limit, size_t offset) const {
+    if (limit == 0)
+        return;
+    size_t added = 0;
+    std::vector<uint32_t> stack {node};
+    while (!stack.empty()) {
+        uint32_t current = stack.back();
+        stack.pop_back();
+        for (uint32_t entry = nodes[current].firstSong; entry != none; entry = songEntries[entry].next) {
+            if (offset) {
+                --offset;
+                continue;
+            }
+            results.push_back(songEntries[entry].songId);
+            if (++added == limit)
+                return;
+        }
+        // the starting node's siblings are not under the prefix
+        if (current != node && nodes[current].nextSibling != none)
+            stack.push_back(nodes[current].nextSibling);
+        if (nodes[current].firstChild != none)
+            stack.push_back(nodes[current].firstChild);
+    }
+}
@@ -0,0 +1,62 @@
+//
+// Path compressed (radix / Patricia) trie over song titles. Same
+// insert/search as Trie, but a chain of single child nodes is one edge.
+//
+
+#ifndef RADIXTRIE_H
+#define RADIXTRIE_H
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class RadixTrie {
+public:
+    RadixTrie();
+
+    // songId is the song's index in the song table, the tree only keeps that
+    void insert(std::string_view songName, uint32_t songId);
+    // appends the ids of songs whose title starts with query, skipping the
+    // first offset matches and stopping after limit of them
+    void search(std::string_view query, std::vector<uint32_t> &results,
+                size_t limit = SIZE_MAX, size_t offset = 0) const;
+    // how many songs search() would return with no limit
+    size_t count(std::string_view query) const;
+
+    size_t nodeCount() const { return nodes.size(); }
+    size_t memoryUsage() const;
+
+private:
+    static constexpr uint32_t none = UINT32_MAX;
+
+    // edge labels are spans of labelPool, splitting an edge just splits the span
+    struct RadixNode {
+        uint32_t labelOffset = 0;
+        uint32_t labelLength = 0;
+        uint32_t firstChild = none;  // children are a list sorted by first label byte
+        uint32_t nextSibling = none;
+        uint32_t firstSong = none;
+        uint32_t lastSong = none;
+    };
+
+    struct SongEntry {
+        uint32_t songId;
+        uint32_t next;
+    };
+
+    std::string_view label(const RadixNode &node) const {
+        return {labelPool.data() + node.labelOffset, node.labelLength};
+    }
+    uint32_t findChild(uint32_t node, char first) const;
+    // node everything starting with query is under, or none
+    uint32_t findNode(std::string_view query) const;
+    uint32_t addChild(uint32_t parent, std::string_view key);
+    void addSong(uint32_t node, uint32_t songId);
+    void collectSongs(uint32_t node, std::vector<uint32_t> &results, size_t limit, size_t offset) const;
+
+    std::vector<RadixNode> nodes;
+    std::vector<SongEntry> songEntries;
+    std::string labelPool;
+};
+
+#endif //RADIXTRIE_H
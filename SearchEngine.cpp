@@ -0,0 +1,209 @@
+//
+// One interface over the title prefix indexes, so the app and the
+// benchmark can pick one by name and compare them on the same songs
+//
+
+#include "SearchEngine.h"
+#include "AdaptiveRadixTree.h"
+#include "DoubleArrayTrie.h"
+#include "RadixTrie.h"
+#include "SortedPrefixIndex.h"
+#include "TitleFst.h"
+#include "TitleKey.h"
+#include "Trie.h"
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+
+namespace {
+
+// searches a trie built elsewhere until build() makes one of its own
+class TrieEngine : public SearchEngine {
+public:
+    TrieEngine() = default;
+    explicit TrieEngine(const Trie &built) : trie(&built) {}
+    TrieEngine(const TrieEngine &) = delete;
+    TrieEngine &operator=(const TrieEngine &) = delete;
+
+    std::string_view name() const override { return "trie"; }
+    void build(const std::vector<Songs> &songs) override {
+        owned.build(songs);
+        trie = &owned;
+    }
+    void prefixSearch(std::string_view query, std::vector<uint32_t> &results, size_t limit,
+                      size_t offset) const override {
+        trie->search(query, results, limit, offset);
+    }
+    size_t count(std::string_view query) const override { return trie->count(query); }
+    size_t memoryUsage() const override { return trie == &owned ? owned.memoryUsage() : 0; }
+
+private:
+    Trie owned;
+    const Trie *trie = &owned;
+};
+
+// the radix trie and the ART are built by inserting, a fresh tree each time
+template <typename Tree>
+class InsertedEngine : public SearchEngine {
+public:
+    explicit InsertedEngine(std::string_view engineName) : engineName(engineName) {}
+    std::string_view name() const override { return engineName; }
+    void build(const std::vector<Songs> &songs) override {
+        tree = Tree();
+        for (uint32_t id = 0; id < songs.size(); ++id)
+            tree.insert(songs[id].name, id);
+    }
+    void prefixSearch(std::string_view query, std::vector<uint32_t> &results, size_t limit,
+                      size_t offset) const override {
+        tree.search(query, results, limit, offset);
+    }
+    size_t count(std::string_view query) const override { return tree.count(query); }
+    size_t memoryUsage() const override { return tree.memoryUsage(); }
+
+private:
+    std::string_view engineName;
+    Tree tree;
+};
+
+class FstEngine : public SearchEngine {
+public:
+    std::string_view name() const override { return "fst"; }
+    void build(const std::vector<Songs> &songs) override { fst.build(songs); }
+    void prefixSearch(std::string_view query, std::vector<uint32_t> &results, size_t limit,
+                      size_t offset) const override {
+        fst.search(query, results, limit, offset);
+    }
+    size_t count(std::string_view query) const override { return fst.count(query); }
+    size_t memoryUsage() const override { return fst.memoryUsage(); }
+
+private:
+    TitleFst fst;
+};
+
+class DoubleArrayEngine : public SearchEngine {
+public:
+    std::string_view name() const override { return "dat"; }
+    void build(const std::vector<Songs> &songs) override { trie.build(songs); }
+    void prefixSearch(std::string_view query, std::vector<uint32_t> &results, size_t limit,
+                      size_t offset) const override {
+        trie.search(query, results, limit, offset);
+    }
+    size_t count(std::string_view query) const override { return trie.count(query); }
+    size_t memoryUsage() const override { return trie.memoryUsage(); }
+
+private:
+    DoubleArrayTrie trie;
+};
+
+// title key to the songs with it. a hash map has no order, so a prefix
+// search has to look at every key and sort the ones that match.
+class MapEngine : public SearchEngine {
+public:
+    std::string_view name() const override { return "map"; }
+
+    void build(const std::vector<Songs> &songs) override {
+        songMap.clear();
+        for (uint32_t id = 0; id < songs.size(); ++id)
+            songMap[titleKey(songs[id].name)].push_back(id);
+    }
+
+    void prefixSearch(std::string_view query, std::vector<uint32_t> &results, size_t limit,
+                      size_t offset) const override {
+        std::string key = titleKey(query);
+        std::vector<const Entry *> matching;
+        for (const Entry &entry : songMap) {
+            if (entry.first.starts_with(key))
+                matching.push_back(&entry);
+        }
+        std::sort(matching.begin(), matching.end(), [](const Entry *a, const Entry *b) { return a->first < b->first; });
+
+        size_t added = 0;
+        for (const Entry *entry : matching) {
+            for (uint32_t id : entry->second) {
+                if (added == limit)
+                    return;
+                if (offset) {
+                    --offset;
+                    continue;
+                }
+                results.push_back(id);
+                ++added;
+            }
+        }
+    }
+
+    size_t count(std::string_view query) const override {
+        std::string key = titleKey(query);
+        size_t songs = 0;
+        for (const Entry &entry : songMap) {
+            if (entry.first.starts_with(key))
+                songs += entry.second.size();
+        }
+        return songs;
+    }
+
+    // about, the nodes' layout is up to the library
+    size_t memoryUsage() const override {
+        size_t bytes = songMap.bucket_count() * sizeof(void *);
+        for (const Entry &entry : songMap) {
+            bytes += sizeof(void *) + sizeof(size_t) + sizeof(Entry) + entry.second.capacity() * sizeof(uint32_t);
+            if (entry.first.capacity() > std::string().capacity())
+                bytes += entry.first.capacity() + 1;
+        }
+        return bytes;
+    }
+
+private:
+    using Entry = std::pair<const std::string, std::vector<uint32_t>>;
+    std::unordered_map<std::string, std::vector<uint32_t>> songMap;
+};
+
+class SortedEngine : public SearchEngine {
+public:
+    explicit SortedEngine(SortedPrefixIndex::Layout layout) : layout(layout) {}
+    std::string_view name() const override {
+        return layout == SortedPrefixIndex::Layout::Sorted ? "sorted" : "eytzinger";
+    }
+    void build(const std::vector<Songs> &songs) override { index.build(songs, layout); }
+    void prefixSearch(std::string_view query, std::vector<uint32_t> &results, size_t limit,
+                      size_t offset) const override {
+        index.search(query, results, limit, offset);
+    }
+    size_t count(std::string_view query) const override { return index.count(query); }
+    size_t memoryUsage() const override { return index.memoryUsage(); }
+
+private:
+    SortedPrefixIndex::Layout layout;
+    SortedPrefixIndex index;
+};
+
+}
+
+std::unique_ptr<SearchEngine> makeSearchEngine(std::string_view name) {
+    if (name == "trie")
+        return std::make_unique<TrieEngine>();
+    if (name == "radix")
+        return std::make_unique<InsertedEngine<RadixTrie>>("radix");
+    if (name == "art")
+        return std::make_unique<InsertedEngine<AdaptiveRadixTree>>("art");
+    if (name == "dat")
+        return std::make_unique<DoubleArrayEngine>();
+    if (name == "fst")
+        return std::make_unique<FstEngine>();
+    if (name == "map")
+        return std::make_unique<MapEngine>();
+    if (name == "sorted")
+        return std::make_unique<SortedEngine>(SortedPrefixIndex::Layout::Sorted);
+    if (name == "eytzinger")
+        return std::make_unique<SortedEngine>(SortedPrefixIndex::Layout::Eytzinger);
+    return nullptr;
+}
+
+std::unique_ptr<SearchEngine> makeTrieEngine(const Trie &trie) {
+    return std::make_unique<TrieEngine>(trie);
+}
+
+const std::vector<std::string_view> &searchEngineNames() {
+    static const std::vector<std::string_view> names = {"trie", "radix", "art", "dat", "fst", "map", "sorted", "eytzinger"};
+    return names;
+}
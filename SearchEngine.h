@@ -0,0 +1,42 @@
+//
+// One interface over the title prefix indexes, so the app and the
+// benchmark can pick one by name and compare them on the same songs
+//
+
+#ifndef SEARCHENGINE_H
+#define SEARCHENGINE_H
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+#include "Songs.h"
+
+class Trie;
+
+class SearchEngine {
+public:
+    virtual ~SearchEngine() = default;
+
+    // the name makeSearchEngine() knows it by
+    virtual std::string_view name() const = 0;
+    // replaces whatever was there with an index over the songs' titles
+    virtual void build(const std::vector<Songs> &songs) = 0;
+    // appends the ids of songs whose title starts with query, by title key
+    // then id, skipping offset of them and stopping after limit
+    virtual void prefixSearch(std::string_view query, std::vector<uint32_t> &results,
+                              size_t limit = SIZE_MAX, size_t offset = 0) const = 0;
+    // how many songs prefixSearch() would return with no limit
+    virtual size_t count(std::string_view query) const = 0;
+    virtual size_t memoryUsage() const = 0;
+};
+
+// "trie", "radix", "art" (adaptive radix tree), "dat" (double-array trie),
+// "fst", "map" (the unordered_map the app used to have), "sorted" or
+// "eytzinger". null for any other name.
+std::unique_ptr<SearchEngine> makeSearchEngine(std::string_view name);
+// the "trie" engine over a trie that is already built, which has to outlive
+// it. its memory is counted where it lives, not here.
+std::unique_ptr<SearchEngine> makeTrieEngine(const Trie &trie);
+const std::vector<std::string_view> &searchEngineNames();
+
+#endif //SEARCHENGINE_H
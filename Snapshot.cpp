@@ -0,0 +1,206 @@
+//
+// Binary snapshot of the song table and the title trie, so a restart does
+// not have to parse the csv and rebuild the index again
+//
+
+#include "Snapshot.h"
+#include "Checksum.h"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace {
+
+// file layout, everything little endian as written by the machine:
+//   SnapshotHeader
+//   SongRecord[songCount]
+//   string blob: names, authors and lyrics (blobBytes, padded to a multiple of 8)
+//   trie words (uint32_t[trieWords])
+constexpr char snapshotMagic[8] = {'S', 'O', 'N', 'G', 'S', 'N', 'A', 'P'};
+constexpr uint32_t snapshotVersion = 7; // bumped whenever titleKey() or the layout changes
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t songCount;
+    uint64_t blobBytes;
+    uint64_t trieWords;
+    uint64_t checksum; // of everything after the header
+    // the csv the songs came from, as it was when they were loaded
+    uint64_t csvSize;
+    int64_t csvTime;
+};
+
+struct SongRecord {
+    uint64_t nameOffset;
+    uint64_t authorOffset;
+    uint64_t textOffset;
+    uint32_t nameLength;
+    uint32_t authorLength;
+    uint32_t textLength;
+    uint32_t unused;
+};
+
+uint64_t paddedBlob(uint64_t bytes) {
+    return (bytes + 7) & ~uint64_t(7);
+}
+
+// size and modification time of the csv, false if it isn't there
+bool csvStamp(const std::string& csvFile, uint64_t& size, int64_t& time) {
+    std::error_code error;
+    size = std::filesystem::file_size(csvFile, error);
+    if (error)
+        return false;
+    time = static_cast<int64_t>(std::filesystem::last_write_time(csvFile, error).time_since_epoch().count());
+    return !error;
+}
+
+}
+
+bool snapshotIsFresh(const std::string& snapshotFile, const std::string& csvFile) {
+    SnapshotHeader header {};
+    std::ifstream file(snapshotFile, std::ios::binary);
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))
+        || std::memcmp(header.magic, snapshotMagic, sizeof(header.magic)) != 0 || header.version != snapshotVersion)
+        return false;
+    uint64_t csvSize;
+    int64_t csvTime;
+    // no csv at all means the snapshot is all we have. otherwise it has to be
+    // the very csv the snapshot was made from, an older mtime is not enough
+    // (cp -p and archives keep the original one)
+    if (!csvStamp(csvFile, csvSize, csvTime))
+        return true;
+    return csvSize == header.csvSize && csvTime == header.csvTime;
+}
+
+bool writeSnapshot(const std::string& snapshotFile, const std::string& csvFile, const std::vector<Songs>& songs,
+                   const Trie& trie) {
+    uint64_t csvSize;
+    int64_t csvTime;
+    if (!csvStamp(csvFile, csvSize, csvTime)) {
+        std::cerr << "Error reading the size and time of " << csvFile << std::endl;
+        return false;
+    }
+
+    std::vector<SongRecord> records;
+    records.reserve(songs.size());
+    std::string blob;
+    size_t blobBytes = 0;
+    for (const Songs& song : songs)
+        blobBytes += song.name.size() + song.author.size() + song.text.size();
+    blob.reserve(paddedBlob(blobBytes)); // the lyrics make this most of the file
+
+    for (const Songs& song : songs) {
+        SongRecord record {};
+        record.nameOffset = blob.size();
+        record.nameLength = static_cast<uint32_t>(song.name.size());
+        blob += song.name;
+        record.authorOffset = blob.size();
+        record.authorLength = static_cast<uint32_t>(song.author.size());
+        blob += song.author;
+        record.textOffset = blob.size();
+        record.textLength = static_cast<uint32_t>(song.text.size());
+        blob += song.text;
+        records.push_back(record);
+    }
+    blob.resize(paddedBlob(blobBytes), '\0');
+
+    std::vector<uint32_t> trieWords;
+    trie.save(trieWords);
+
+    // written straight from the three pieces, the blob holds all the lyrics
+    // and is too big to copy again. each piece is a multiple of 8 bytes.
+    static_assert(sizeof(SongRecord) % 8 == 0, "records are checksummed as 8 byte words");
+    std::string_view pieces[] = {
+        {reinterpret_cast<const char*>(records.data()), records.size() * sizeof(SongRecord)},
+        blob,
+        {reinterpret_cast<const char*>(trieWords.data()), trieWords.size() * sizeof(uint32_t)},
+    };
+
+    SnapshotHeader header {};
+    std::memcpy(header.magic, snapshotMagic, sizeof(header.magic));
+    header.version = snapshotVersion;
+    header.songCount = static_cast<uint32_t>(songs.size());
+    header.blobBytes = blobBytes;
+    header.trieWords = trieWords.size();
+    header.csvSize = csvSize;
+    header.csvTime = csvTime;
+    header.checksum = checksumStart;
+    for (std::string_view piece : pieces)
+        header.checksum = checksum(piece.data(), piece.size(), header.checksum);
+
+    std::string tempFile = snapshotFile + ".tmp";
+    {
+        std::ofstream file(tempFile, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            std::cerr << "Error opening file " << tempFile << std::endl;
+            return false;
+        }
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        for (std::string_view piece : pieces)
+            file.write(piece.data(), static_cast<std::streamsize>(piece.size()));
+        if (!file) {
+            std::cerr << "Error writing file " << tempFile << std::endl;
+            return false;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(tempFile, snapshotFile, error);
+    if (error) {
+        std::cerr << "Error renaming " << tempFile << " to " << snapshotFile << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool loadSnapshot(const std::string& snapshotFile, MappedFile& storage, std::vector<Songs>& songs, Trie& trie) {
+    // read through once for the checksum, then the lyrics are opened in any
+    // order as songs are shown, so neither hint fits
+    MappedFile file(snapshotFile, MappedFile::Access::Normal);
+    if (!file.isOpen() || file.size() < sizeof(SnapshotHeader))
+        return false;
+
+    SnapshotHeader header {};
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, snapshotMagic, sizeof(header.magic)) != 0 || header.version != snapshotVersion)
+        return false;
+
+    uint64_t recordBytes = uint64_t(header.songCount) * sizeof(SongRecord);
+    uint64_t expected = sizeof(header) + recordBytes + paddedBlob(header.blobBytes) + header.trieWords * sizeof(uint32_t);
+    if (expected != file.size())
+        return false;
+
+    const char* payload = file.data() + sizeof(header);
+    if (checksum(payload, file.size() - sizeof(header)) != header.checksum) {
+        std::cerr << "Snapshot " << snapshotFile << " is corrupt, ignoring it" << std::endl;
+        return false;
+    }
+
+    auto records = reinterpret_cast<const SongRecord*>(payload);
+    const char* blob = payload + recordBytes;
+    auto trieWords = reinterpret_cast<const uint32_t*>(blob + paddedBlob(header.blobBytes));
+
+    std::vector<Songs> loaded;
+    loaded.reserve(header.songCount);
+    for (uint32_t i = 0; i < header.songCount; ++i) {
+        const SongRecord& record = records[i];
+        if (record.nameOffset + record.nameLength > header.blobBytes
+            || record.authorOffset + record.authorLength > header.blobBytes
+            || record.textOffset + record.textLength > header.blobBytes)
+            return false;
+        loaded.emplace_back(std::string_view(blob + record.nameOffset, record.nameLength),
+                            std::string_view(blob + record.authorOffset, record.authorLength),
+                            std::string_view(blob + record.textOffset, record.textLength));
+    }
+
+    Trie loadedTrie;
+    if (!loadedTrie.load(trieWords, header.trieWords, header.songCount))
+        return false;
+
+    storage = std::move(file);
+    songs = std::move(loaded);
+    trie = std::move(loadedTrie);
+    return true;
+}
@@ -0,0 +1,30 @@
+//
+// Binary snapshot of the song table and the title trie, so a restart does
+// not have to parse the csv and rebuild the index again
+//
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+#include <string>
+#include <vector>
+#include "MappedFile.h"
+#include "Songs.h"
+#include "Trie.h"
+
+// true if the snapshot exists and was made from the csv as it is now, same
+// size and modification time, or if there is no csv to rebuild from
+bool snapshotIsFresh(const std::string& snapshotFile, const std::string& csvFile);
+
+// writes songs and trie to snapshotFile (through a temp file, so a crash
+// never leaves a half written snapshot behind), stamped with the size and
+// time of csvFile they were loaded from
+bool writeSnapshot(const std::string& snapshotFile, const std::string& csvFile, const std::vector<Songs>& songs,
+                   const Trie& trie);
+
+// maps snapshotFile into storage and fills songs/trie from it. the songs
+// point into storage, so it has to stay open as long as they are used.
+// returns false (and leaves songs/trie alone) on a bad magic, version,
+// size or checksum.
+bool loadSnapshot(const std::string& snapshotFile, MappedFile& storage, std::vector<Songs>& songs, Trie& trie);
+
+#endif //SNAPSHOT_H
@@ -0,0 +1,84 @@
+//
+// Builds the song table from the csv without copying any of the text
+//
+
+#include "SongLoader.h"
+#include "CsvParser.h"
+#include "Parallel.h"
+
+namespace {
+
+// below this a chunk is not worth a thread
+constexpr size_t minChunkBytes = 1 << 20;
+
+void parseRange(char* begin, char* end, std::vector<Songs>& songs) {
+    // roughly one song per 250 bytes on the spotify dump, saves most regrowth
+    songs.reserve((end - begin) / 256);
+
+    CsvParser parser(begin, end);
+    std::vector<std::string_view> fields;
+
+    // columns are artist, song, link, text
+    while (parser.nextRecord(fields)) {
+        if (fields.size() < 2)
+            continue; // blank line
+        songs.emplace_back(fields[1], fields[0], fields.size() > 3 ? fields[3] : std::string_view());
+    }
+}
+
+}
+
+std::vector<Songs> loadSongs(MappedFile& file, unsigned threadCount) {
+    std::vector<Songs> songs;
+    if (!file.isOpen())
+        return songs;
+
+    char* data = file.data();
+    size_t size = file.size();
+
+    if (threadCount == 0)
+        threadCount = defaultThreadCount();
+    threadCount = static_cast<unsigned>(std::clamp<size_t>(size / minChunkBytes, 1, threadCount));
+    size_t chunkBytes = size / threadCount;
+
+    // split into equal byte ranges first, the real cut points come later
+    std::vector<size_t> cuts(threadCount + 1);
+    for (unsigned i = 0; i < threadCount; ++i)
+        cuts[i] = i * chunkBytes;
+    cuts[threadCount] = size;
+
+    // a range starts inside a quoted field exactly when an odd number of
+    // quotes come before it, so count the quotes in each range in parallel
+    std::vector<size_t> quotes(threadCount);
+    runOnThreads(threadCount, [&](unsigned i) {
+        quotes[i] = std::count(data + cuts[i], data + cuts[i + 1], '"');
+    });
+
+    // move every cut forward to the start of the next real record. the cut
+    // at 0 also moves, which skips the header line.
+    std::vector<char*> starts(threadCount + 1);
+    size_t quotesBefore = 0;
+    for (unsigned i = 0; i < threadCount; ++i) {
+        bool inQuote = quotesBefore % 2 == 1;
+        starts[i] = const_cast<char*>(CsvParser::nextRecordStart(data + cuts[i], data + size, inQuote));
+        quotesBefore += quotes[i];
+    }
+    starts[threadCount] = data + size;
+    // a record longer than a whole chunk can push a cut past the next one
+    for (unsigned i = 1; i <= threadCount; ++i)
+        starts[i] = std::max(starts[i], starts[i - 1]);
+
+    std::vector<std::vector<Songs>> batches(threadCount);
+    runOnThreads(threadCount, [&](unsigned i) {
+        parseRange(starts[i], starts[i + 1], batches[i]);
+    });
+
+    // stitch the batches back together in file order
+    size_t total = 0;
+    for (const auto& batch : batches)
+        total += batch.size();
+    songs.reserve(total);
+    for (const auto& batch : batches)
+        songs.insert(songs.end(), batch.begin(), batch.end());
+    return songs;
+}
@@ -0,0 +1,17 @@
+//
+// Builds the song table from the csv without copying any of the text
+//
+
+#ifndef SONGLOADER_H
+#define SONGLOADER_H
+#include <vector>
+#include "MappedFile.h"
+#include "Songs.h"
+
+// every Songs field is a view into file, so file has to outlive the vector.
+// quoted fields are unescaped inside the (private) mapping while loading.
+// the file is parsed in byte ranges on threadCount threads (0 = one per core)
+// and the songs come back in file order.
+std::vector<Songs> loadSongs(MappedFile& file, unsigned threadCount = 0);
+
+#endif //SONGLOADER_H
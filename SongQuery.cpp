@@ -0,0 +1,451 @@
+//
+// Small boolean query language over the word indexes, e.g.
+//   love AND (artist:abba OR artist:queen) NOT lyrics:money
+//   title:danc* -artist:madonna
+// AND/OR/NOT are upper case, words next to each other are ANDed, a leading
+// - is NOT and a trailing * makes a word a prefix. Bare words are title
+// words. A query compiles into a tree of lazy iterators that only move as
+// far as the songs asked for.
+//
+
+#include "SongQuery.h"
+#include "TitleKey.h"
+#include <algorithm>
+#include <iostream>
+#include <string>
+
+namespace {
+
+// one posting list
+class PostingIterator : public SongIterator {
+public:
+    explicit PostingIterator(const WordIndex::Cursor &cursor) : cursor(cursor) {}
+    bool atEnd() const override { return cursor.atEnd(); }
+    uint32_t song() const override { return cursor.song(); }
+    void next() override { cursor.next(); }
+    void advance(uint32_t song) override { cursor.advance(song); }
+    size_t cost() const override { return atEnd() ? 0 : cursor.songCount(); }
+
+private:
+    WordIndex::Cursor cursor;
+};
+
+// every song, what a query that starts with NOT takes away from
+class AllIterator : public SongIterator {
+public:
+    explicit AllIterator(size_t songCount) : count(static_cast<uint32_t>(songCount)) {}
+    bool atEnd() const override { return current >= count; }
+    uint32_t song() const override { return current; }
+    void next() override { ++current; }
+    void advance(uint32_t song) override { current = std::max(current, song); }
+    size_t cost() const override { return count; }
+
+private:
+    uint32_t count;
+    uint32_t current = 0;
+};
+
+// songs in all the children. the cheapest one leads and the rest jump to
+// its songs, so the big lists are mostly skipped.
+class IntersectIterator : public SongIterator {
+public:
+    explicit IntersectIterator(std::vector<std::unique_ptr<SongIterator>> parts) : children(std::move(parts)) {
+        std::sort(children.begin(), children.end(), [](const auto &a, const auto &b) { return a->cost() < b->cost(); });
+        align();
+    }
+    bool atEnd() const override { return ended || children[0]->atEnd(); }
+    uint32_t song() const override { return children[0]->song(); }
+    void next() override {
+        children[0]->next();
+        align();
+    }
+    void advance(uint32_t song) override {
+        children[0]->advance(song);
+        align();
+    }
+    size_t cost() const override { return children[0]->cost(); }
+
+private:
+    void align() {
+        SongIterator &lead = *children[0];
+        while (!lead.atEnd()) {
+            uint32_t candidate = lead.song();
+            bool everywhere = true;
+            for (size_t i = 1; i < children.size(); ++i) {
+                children[i]->advance(candidate);
+                if (children[i]->atEnd()) {
+                    ended = true;
+                    return;
+                }
+                if (children[i]->song() != candidate) {
+                    lead.advance(children[i]->song());
+                    everywhere = false;
+                    break;
+                }
+            }
+            if (everywhere)
+                return;
+        }
+    }
+
+    std::vector<std::unique_ptr<SongIterator>> children;
+    bool ended = false;
+};
+
+// songs in any of the children, merged through a heap on their current
+// song so only the ones at the front ever move
+class UnionIterator : public SongIterator {
+public:
+    explicit UnionIterator(std::vector<std::unique_ptr<SongIterator>> parts) : children(std::move(parts)) {
+        for (const auto &child : children)
+            total += child->cost();
+        std::erase_if(children, [](const auto &child) { return child->atEnd(); });
+        std::make_heap(children.begin(), children.end(), later);
+    }
+    bool atEnd() const override { return children.empty(); }
+    uint32_t song() const override { return children.front()->song(); }
+    void next() override {
+        uint32_t current = song();
+        while (!children.empty() && children.front()->song() == current)
+            moveFront([](SongIterator &child) { child.next(); });
+    }
+    void advance(uint32_t song) override {
+        while (!children.empty() && children.front()->song() < song)
+            moveFront([song](SongIterator &child) { child.advance(song); });
+    }
+    size_t cost() const override { return total; }
+
+private:
+    static bool later(const std::unique_ptr<SongIterator> &a, const std::unique_ptr<SongIterator> &b) {
+        return a->song() > b->song();
+    }
+    template <typename Move>
+    void moveFront(Move move) {
+        std::pop_heap(children.begin(), children.end(), later);
+        move(*children.back());
+        if (children.back()->atEnd())
+            children.pop_back();
+        else
+            std::push_heap(children.begin(), children.end(), later);
+    }
+
+    std::vector<std::unique_ptr<SongIterator>> children;
+    size_t total = 0;
+};
+
+// songs in include but not in exclude
+class DifferenceIterator : public SongIterator {
+public:
+    DifferenceIterator(std::unique_ptr<SongIterator> include, std::unique_ptr<SongIterator> exclude)
+        : include(std::move(include)), exclude(std::move(exclude)) {
+        skipExcluded();
+    }
+    bool atEnd() const override { return include->atEnd(); }
+    uint32_t song() const override { return include->song(); }
+    void next() override {
+        include->next();
+        skipExcluded();
+    }
+    void advance(uint32_t song) override {
+        include->advance(song);
+        skipExcluded();
+    }
+    size_t cost() const override { return include->cost(); }
+
+private:
+    void skipExcluded() {
+        while (!include->atEnd()) {
+            exclude->advance(include->song());
+            if (exclude->atEnd() || exclude->song() != include->song())
+                return;
+            include->next();
+        }
+    }
+
+    std::unique_ptr<SongIterator> include;
+    std::unique_ptr<SongIterator> exclude;
+};
+
+enum class TokenType { Word, And, Or, Not, Open, Close, End };
+
+struct Token {
+    TokenType type;
+    std::string_view text;
+};
+
+// words run up to a space or a bracket. a - only means NOT at the start
+// of a word, so titles like "rock-a-bye" stay one word.
+std::vector<Token> tokenize(std::string_view query) {
+    std::vector<Token> tokens;
+    size_t pos = 0;
+    while (pos < query.size()) {
+        char c = query[pos];
+        if (c == ' ' || c == '\t') {
+            ++pos;
+        } else if (c == '(' || c == ')') {
+            tokens.push_back({c == '(' ? TokenType::Open : TokenType::Close, query.substr(pos, 1)});
+            ++pos;
+        } else if (c == '-' && pos + 1 < query.size() && query[pos + 1] != ' ') {
+            tokens.push_back({TokenType::Not, query.substr(pos, 1)});
+            ++pos;
+        } else {
+            size_t end = query.find_first_of(" \t()", pos);
+            if (end == std::string_view::npos)
+                end = query.size();
+            std::string_view word = query.substr(pos, end - pos);
+            TokenType type = word == "AND" ? TokenType::And
+                           : word == "OR"  ? TokenType::Or
+                           : word == "NOT" ? TokenType::Not
+                                           : TokenType::Word;
+            tokens.push_back({type, word});
+            pos = end;
+        }
+    }
+    tokens.push_back({TokenType::End, {}});
+    return tokens;
+}
+
+enum class Field { Title, Artist, Lyrics };
+
+constexpr std::pair<std::string_view, Field> fields[] = {
+    {"title:", Field::Title}, {"artist:", Field::Artist}, {"lyrics:", Field::Lyrics}};
+
+// the field names are ASCII, so folding ASCII is enough, "Artist:" is "artist:"
+bool startsWithName(std::string_view word, std::string_view name) {
+    if (word.size() < name.size())
+        return false;
+    for (size_t i = 0; i < name.size(); ++i) {
+        char c = word[i];
+        if (c >= 'A' && c <= 'Z')
+            c = static_cast<char>(c - 'A' + 'a');
+        if (c != name[i])
+            return false;
+    }
+    return true;
+}
+
+// takes a known field off the front of word, "artist:abba" is abba in
+// Field::Artist, in any case. anything else stays whole.
+bool splitField(std::string_view &word, Field &field) {
+    for (auto [name, named] : fields) {
+        if (startsWithName(word, name)) {
+            word.remove_prefix(name.size());
+            field = named;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool hasField(std::string_view word) {
+    Field field;
+    return splitField(word, field);
+}
+
+// recursive descent, lowest precedence first:
+//   or    := and (OR and)*
+//   and   := unary ((AND)? unary)*
+//   unary := NOT unary | field:(or) | (or) | field:word
+class Parser {
+public:
+    Parser(std::string_view query, const QueryIndexes &indexes) : tokens(tokenize(query)), indexes(indexes) {}
+
+    std::unique_ptr<SongIterator> parse() {
+        if (peek() == TokenType::End)
+            return fail("the query is empty");
+        auto root = parseOr(Field::Title);
+        if (root && peek() != TokenType::End)
+            return fail("unexpected \"" + std::string(tokens[pos].text) + "\"");
+        return root;
+    }
+
+private:
+    TokenType peek() const { return tokens[pos].type; }
+
+    std::unique_ptr<SongIterator> fail(const std::string &message) {
+        std::cerr << "Query error: " << message << std::endl;
+        return nullptr;
+    }
+
+    std::unique_ptr<SongIterator> parseOr(Field field) {
+        std::vector<std::unique_ptr<SongIterator>> parts;
+        while (true) {
+            auto part = parseAnd(field);
+            if (!part)
+                return nullptr;
+            parts.push_back(std::move(part));
+            if (peek() != TokenType::Or)
+                break;
+            ++pos;
+        }
+        if (parts.size() == 1)
+            return std::move(parts[0]);
+        return std::make_unique<UnionIterator>(std::move(parts));
+    }
+
+    // the NOT parts are pulled out and taken away from the rest at once,
+    // all of it only if there is nothing else
+    std::unique_ptr<SongIterator> parseAnd(Field field) {
+        std::vector<std::unique_ptr<SongIterator>> include;
+        std::vector<std::unique_ptr<SongIterator>> exclude;
+        while (peek() != TokenType::Or && peek() != TokenType::Close && peek() != TokenType::End) {
+            if (peek() == TokenType::And) {
+                ++pos;
+                continue;
+            }
+            bool negated = peek() == TokenType::Not;
+            if (negated)
+                ++pos;
+            auto part = parseUnary(field);
+            if (!part)
+                return nullptr;
+            (negated ? exclude : include).push_back(std::move(part));
+        }
+        if (include.empty() && exclude.empty()) {
+            if (peek() == TokenType::End)
+                return fail("the query ends too soon");
+            return fail("missing a word before \"" + std::string(tokens[pos].text) + "\"");
+        }
+
+        std::unique_ptr<SongIterator> result;
+        if (include.empty())
+            result = std::make_unique<AllIterator>(indexes.songCount);
+        else if (include.size() == 1)
+            result = std::move(include[0]);
+        else
+            result = std::make_unique<IntersectIterator>(std::move(include));
+        if (exclude.empty())
+            return result;
+        auto excluded = exclude.size() == 1 ? std::move(exclude[0])
+                                            : std::make_unique<UnionIterator>(std::move(exclude));
+        return std::make_unique<DifferenceIterator>(std::move(result), std::move(excluded));
+    }
+
+    std::unique_ptr<SongIterator> parseUnary(Field field) {
+        if (peek() == TokenType::Not) {
+            ++pos;
+            auto part = parseUnary(field);
+            if (!part)
+                return nullptr;
+            return std::make_unique<DifferenceIterator>(std::make_unique<AllIterator>(indexes.songCount),
+                                                        std::move(part));
+        }
+        if (peek() == TokenType::Word) {
+            std::string_view word = tokens[pos].text;
+            Field wordField = field;
+            splitField(word, wordField);
+            ++pos;
+            // "artist:(abba OR queen)" puts the field on the whole group
+            if (word.empty() && peek() == TokenType::Open)
+                return parseGroup(wordField);
+            return parseWord(wordField, word);
+        }
+        if (peek() == TokenType::Open)
+            return parseGroup(field);
+        if (peek() == TokenType::End)
+            return fail("the query ends too soon");
+        return fail("unexpected \"" + std::string(tokens[pos].text) + "\"");
+    }
+
+    std::unique_ptr<SongIterator> parseGroup(Field field) {
+        ++pos;
+        auto group = parseOr(field);
+        if (!group)
+            return nullptr;
+        if (peek() != TokenType::Close)
+            return fail("missing )");
+        ++pos;
+        return group;
+    }
+
+    // one word of the query can be several index words ("don't-stop" is
+    // dont and stop), all of them have to be there. a * applies to the last.
+    std::unique_ptr<SongIterator> parseWord(Field field, std::string_view text) {
+        const WordIndex *index = field == Field::Title  ? indexes.titles
+                                 : field == Field::Artist ? indexes.artists
+                                                          : indexes.lyrics;
+        if (!index)
+            return fail("that field is not indexed");
+        bool prefix = text.ends_with('*');
+        std::vector<std::string> words;
+        std::string word;
+        size_t wordPos = 0;
+        while (nextWord(text, wordPos, word))
+            words.push_back(word);
+        if (words.empty())
+            return fail("nothing to search for in \"" + std::string(text) + "\"");
+
+        std::vector<std::unique_ptr<SongIterator>> parts;
+        for (size_t i = 0; i < words.size(); ++i) {
+            if (prefix && i + 1 == words.size()) {
+                std::vector<WordIndex::Cursor> cursors;
+                size_t matching = index->prefixCursors(words[i], cursors, maxPrefixWords);
+                if (matching > maxPrefixWords)
+                    std::cerr << "Query warning: " << words[i] << "* matches " << matching << " words, only the "
+                              << maxPrefixWords << " most used are searched, so songs may be missing" << std::endl;
+                std::vector<std::unique_ptr<SongIterator>> expanded;
+                for (const WordIndex::Cursor &cursor : cursors)
+                    expanded.push_back(std::make_unique<PostingIterator>(cursor));
+                parts.push_back(std::make_unique<UnionIterator>(std::move(expanded)));
+            } else {
+                parts.push_back(std::make_unique<PostingIterator>(index->cursor(words[i])));
+            }
+        }
+        if (parts.size() == 1)
+            return std::move(parts[0]);
+        return std::make_unique<IntersectIterator>(std::move(parts));
+    }
+
+    std::vector<Token> tokens;
+    size_t pos = 0;
+    const QueryIndexes &indexes;
+};
+
+}
+
+std::unique_ptr<SongIterator> parseQuery(std::string_view query, const QueryIndexes &indexes) {
+    return Parser(query, indexes).parse();
+}
+
+void takeSongs(SongIterator &iterator, std::vector<uint32_t> &results, size_t limit) {
+    for (size_t taken = 0; taken < limit && !iterator.atEnd(); ++taken) {
+        results.push_back(iterator.song());
+        iterator.next();
+    }
+}
+
+bool isQuery(std::string_view input) {
+    std::vector<Token> tokens = tokenize(input);
+    for (size_t i = 0; i < tokens.size(); ++i) {
+        const Token &token = tokens[i];
+        if (token.type == TokenType::End)
+            break;
+        // brackets alone are in plenty of titles, "Hello (Remix)", only a
+        // field: right before one makes it a group
+        if (token.type == TokenType::Open || token.type == TokenType::Close) {
+            if (token.type == TokenType::Open && i > 0 && tokens[i - 1].type == TokenType::Word
+                && tokens[i - 1].text.ends_with(':') && hasField(tokens[i - 1].text))
+                return true;
+            continue;
+        }
+        if (token.type != TokenType::Word)
+            return true;
+        if (token.text.ends_with('*') || startsWithName(token.text, "title:") || (i > 0 && hasField(token.text)))
+            return true;
+    }
+    return false;
+}
+
+std::string foldFields(std::string_view input) {
+    std::string folded(input);
+    for (size_t pos = 0; pos < folded.size(); ++pos) {
+        // only at the start of a word, as the tokenizer would see it
+        if (pos > 0 && std::string_view(" \t(-").find(folded[pos - 1]) == std::string_view::npos)
+            continue;
+        for (const auto &field : fields) {
+            if (startsWithName(std::string_view(folded).substr(pos), field.first))
+                folded.replace(pos, field.first.size(), field.first);
+        }
+    }
+    return folded;
+}
@@ -0,0 +1,65 @@
+//
+// Small boolean query language over the word indexes, e.g.
+//   love AND (artist:abba OR artist:queen) NOT lyrics:money
+//   title:danc* -artist:madonna
+// AND/OR/NOT are upper case, words next to each other are ANDed, a leading
+// - is NOT and a trailing * makes a word a prefix. Bare words are title
+// words. A query compiles into a tree of lazy iterators that only move as
+// far as the songs asked for.
+//
+
+#ifndef SONGQUERY_H
+#define SONGQUERY_H
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "WordIndex.h"
+
+// walks song ids in ascending order. song() is only valid while not atEnd().
+class SongIterator {
+public:
+    virtual ~SongIterator() = default;
+    virtual bool atEnd() const = 0;
+    virtual uint32_t song() const = 0;
+    virtual void next() = 0;
+    // moves to the first song at or past song, never backwards
+    virtual void advance(uint32_t song) = 0;
+    // about how many songs it goes through, the cheapest lead an intersection
+    virtual size_t cost() const = 0;
+};
+
+// what each field is searched in. lyrics may be null if it isn't built.
+struct QueryIndexes {
+    const WordIndex *titles = nullptr;
+    const WordIndex *artists = nullptr;
+    const WordIndex *lyrics = nullptr;
+    size_t songCount = 0;
+};
+
+// words a prefix expands to at most, the most used ones. every one is a
+// cursor with its block decoded, so a prefix like a* can't take them all.
+// parseQuery() warns on cerr when a prefix is cut short.
+constexpr size_t maxPrefixWords = 1024;
+
+// compiles query, or returns null and says why on cerr. the indexes have
+// to outlive the iterator.
+std::unique_ptr<SongIterator> parseQuery(std::string_view query, const QueryIndexes &indexes);
+
+// appends the next limit songs from iterator, only those get found. it is
+// left past them, so the next call carries on with the songs after.
+void takeSongs(SongIterator &iterator, std::vector<uint32_t> &results, size_t limit);
+
+// whether input uses the query syntax: an operator, a - or *, a title:
+// qualifier, a qualifier after the first word or one in front of a bracket.
+// brackets on their own don't count, titles have them. a plain "artist:" or
+// "lyrics:" search at the start is left to those indexes.
+bool isQuery(std::string_view input);
+
+// input with the field names lower cased wherever a word starts with one,
+// "Artist:ABBA" is "artist:ABBA", so a plain starts_with("artist:") finds it.
+// the query parser already takes them in any case.
+std::string foldFields(std::string_view input);
+
+#endif //SONGQUERY_H
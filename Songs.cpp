@@ -9,3 +9,9 @@ Songs::Songs() {
     this->author = "author";
 }
 
+Songs::Songs(std::string_view name, std::string_view author, std::string_view text) {
+    this->name = name;
+    this->author = author;
+    this->text = text;
+}
+
@@ -4,16 +4,18 @@
 
 #ifndef SONGS_H
 #define SONGS_H
-#include <string>
+#include <string_view>
 
 
 class Songs {
     public:
-    std::string name ;
-    std::string author;
+    // views into the loaded catalog file, nothing is copied per song
+    std::string_view name ;
+    std::string_view author;
+    std::string_view text; // lyrics, empty if the file has none
 
      Songs();
-    // Songs(std::string name, std::string author);
+     Songs(std::string_view name, std::string_view author, std::string_view text = {});
 
 };
 
@@ -0,0 +1,126 @@
+//
+// Title index kept as plain sorted arrays: every song's normalized title in
+// one blob, sorted, with offsets into it. A prefix query is two lower bounds
+// (the prefix and the first key past it), so the matches and their count
+// come out as one range.
+//
+
+#include "SortedPrefixIndex.h"
+#include "BranchlessSearch.h"
+#include "TitleKey.h"
+#include <algorithm>
+#include <bit>
+#include <numeric>
+
+namespace {
+
+// keys never hold a 0 byte, so padding with zeros keeps the order
+uint64_t headOf(std::string_view key) {
+    uint64_t head = 0;
+    for (size_t i = 0; i < 8; ++i)
+        head = (head << 8) | (i < key.size() ? static_cast<uint8_t>(key[i]) : 0);
+    return head;
+}
+
+}
+
+void SortedPrefixIndex::build(const std::vector<Songs> &songs, Layout layout) {
+    this->layout = layout;
+    std::vector<std::string> keyOf(songs.size());
+    for (size_t i = 0; i < songs.size(); ++i)
+        keyOf[i] = titleKey(songs[i].name);
+    songIds.resize(songs.size());
+    std::iota(songIds.begin(), songIds.end(), 0u);
+    std::stable_sort(songIds.begin(), songIds.end(), [&](uint32_t a, uint32_t b) { return keyOf[a] < keyOf[b]; });
+
+    keys.clear();
+    offsets.assign(1, 0);
+    for (uint32_t id : songIds) {
+        keys += keyOf[id];
+        offsets.push_back(static_cast<uint32_t>(keys.size()));
+    }
+    keys.shrink_to_fit();
+
+    size_t n = songIds.size();
+    heads.clear();
+    eytzinger.clear();
+    if (layout == Layout::Sorted) {
+        heads.resize(n);
+        for (size_t i = 0; i < n; ++i)
+            heads[i] = headOf(keyAt(i));
+    } else {
+        // an in order walk of the implicit tree visits the slots in sorted order
+        eytzinger.resize(n + 1);
+        heads.resize(n + 1);
+        size_t next = 0;
+        auto fill = [&](auto &self, size_t slot) -> void {
+            if (slot > n)
+                return;
+            self(self, 2 * slot);
+            eytzinger[slot] = static_cast<uint32_t>(next);
+            heads[slot] = headOf(keyAt(next++));
+            self(self, 2 * slot + 1);
+        };
+        fill(fill, 1);
+    }
+}
+
+size_t SortedPrefixIndex::lowerBoundSorted(uint64_t head, std::string_view key) const {
+    return branchlessLowerBound(
+        songIds.size(),
+        [&](size_t i) { return heads[i] != head ? heads[i] < head : keyAt(i) < key; },
+        [&](size_t i) { __builtin_prefetch(heads.data() + i); });
+}
+
+// walks down the implicit tree going right while the slot is below key. the
+// slot we last went left at is the answer, it is found again by dropping the
+// trailing right turns (ones) and that left turn from k.
+size_t SortedPrefixIndex::lowerBoundEytzinger(uint64_t head, std::string_view key) const {
+    size_t n = songIds.size();
+    size_t k = 1;
+    while (k <= n) {
+        // 8 heads are one cache line, the descendants three levels down
+        __builtin_prefetch(heads.data() + std::min(8 * k, n));
+        bool below = heads[k] != head ? heads[k] < head : keyAt(eytzinger[k]) < key;
+        k = 2 * k + below;
+    }
+    k >>= std::countr_one(k) + 1;
+    return k ? eytzinger[k] : n;
+}
+
+size_t SortedPrefixIndex::lowerBound(std::string_view key) const {
+    uint64_t head = headOf(key);
+    return layout == Layout::Sorted ? lowerBoundSorted(head, key) : lowerBoundEytzinger(head, key);
+}
+
+void SortedPrefixIndex::range(std::string_view key, size_t &first, size_t &last) const {
+    first = lowerBound(key);
+    std::string successor;
+    if (!keySuccessor(key, successor)) {
+        last = songIds.size();
+        return;
+    }
+    last = lowerBound(successor);
+}
+
+void SortedPrefixIndex::search(std::string_view query, std::vector<uint32_t> &results, size_t limit,
+                               size_t offset) const {
+    size_t first, last;
+    range(titleKey(query), first, last);
+    if (offset >= last - first)
+        return;
+    first += offset;
+    last = first + std::min(limit, last - first);
+    results.insert(results.end(), songIds.begin() + first, songIds.begin() + last);
+}
+
+size_t SortedPrefixIndex::count(std::string_view query) const {
+    size_t first, last;
+    range(titleKey(query), first, last);
+    return last - first;
+}
+
+size_t SortedPrefixIndex::memoryUsage() const {
+    return keys.capacity() + offsets.capacity() * sizeof(uint32_t) + songIds.capacity() * sizeof(uint32_t)
+         + heads.capacity() * sizeof(uint64_t) + eytzinger.capacity() * sizeof(uint32_t);
+}
@@ -0,0 +1,57 @@
+//
+// Title index kept as plain sorted arrays: every song's normalized title in
+// one blob, sorted, with offsets into it. A prefix query is two lower bounds
+// (the prefix and the first key past it), so the matches and their count
+// come out as one range.
+//
+
+#ifndef SORTEDPREFIXINDEX_H
+#define SORTEDPREFIXINDEX_H
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Songs.h"
+
+class SortedPrefixIndex {
+public:
+    // Sorted searches the sorted order directly, Eytzinger searches a copy of
+    // the search keys laid out as an implicit binary tree (children of slot k
+    // at 2k and 2k + 1), so the next few levels can be prefetched together
+    enum class Layout { Sorted, Eytzinger };
+
+    // replaces whatever was there with an index over songs
+    void build(const std::vector<Songs> &songs, Layout layout = Layout::Sorted);
+
+    // same as Trie::search: ids of songs whose title starts with query, in the
+    // same order, skipping offset matches and stopping after limit
+    void search(std::string_view query, std::vector<uint32_t> &results,
+                size_t limit = SIZE_MAX, size_t offset = 0) const;
+    // how many songs search() would return with no limit
+    size_t count(std::string_view query) const;
+
+    size_t memoryUsage() const;
+
+private:
+    // position range of the keys starting with key
+    void range(std::string_view key, size_t &first, size_t &last) const;
+    size_t lowerBound(std::string_view key) const;
+    size_t lowerBoundSorted(uint64_t head, std::string_view key) const;
+    size_t lowerBoundEytzinger(uint64_t head, std::string_view key) const;
+
+    std::string_view keyAt(size_t position) const {
+        return {keys.data() + offsets[position], offsets[position + 1] - offsets[position]};
+    }
+
+    Layout layout = Layout::Sorted;
+    std::string keys;              // sorted keys back to back
+    std::vector<uint32_t> offsets; // key i is keys[offsets[i] .. offsets[i + 1])
+    std::vector<uint32_t> songIds; // song of key i, table order among equal keys
+    // first 8 key bytes as a big endian number, so most comparisons are one
+    // integer compare that never leaves this array. in sorted order for
+    // Sorted, in Eytzinger order (from slot 1) for Eytzinger.
+    std::vector<uint64_t> heads;
+    std::vector<uint32_t> eytzinger; // Eytzinger slot to sorted position
+};
+
+#endif //SORTEDPREFIXINDEX_H
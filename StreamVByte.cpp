@@ -0,0 +1,166 @@
+//
+// StreamVByte integer codec (Lemire, Kurz and Rupp) for posting lists. A
+// value takes 1 to 4 bytes, and the lengths are kept apart from the data as
+// 2 bit codes, four to a control byte, so a decoder can expand four values
+// at once with one byte shuffle.
+//
+
+#include "StreamVByte.h"
+#include <array>
+
+// the shuffle decoder is compiled for SSSE3 whatever the build targets and
+// only run if the CPU has it, so it doesn't need SONGLIST_NATIVE
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define STREAMVBYTE_SSSE3 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// per control byte: where each of the four values' bytes are in the 16 byte
+// window (0xff for the zero bytes above a short value), and how many data
+// bytes the four take together
+struct DecodeTables {
+    alignas(16) std::array<std::array<uint8_t, 16>, 256> shuffle {};
+    std::array<uint8_t, 256> length {};
+};
+
+constexpr DecodeTables decodeTables = [] {
+    DecodeTables tables {};
+    for (unsigned control = 0; control < 256; ++control) {
+        uint8_t offset = 0;
+        for (unsigned lane = 0; lane < 4; ++lane) {
+            unsigned bytes = ((control >> (2 * lane)) & 3) + 1;
+            for (unsigned b = 0; b < 4; ++b)
+                tables.shuffle[control][lane * 4 + b] = b < bytes ? static_cast<uint8_t>(offset + b) : 0xFF;
+            offset = static_cast<uint8_t>(offset + bytes);
+        }
+        tables.length[control] = offset;
+    }
+    return tables;
+}();
+
+unsigned byteCode(uint32_t value) {
+    return value < (1u << 8) ? 0 : value < (1u << 16) ? 1 : value < (1u << 24) ? 2 : 3;
+}
+
+// Delta picks whether values go in as they are or as differences
+template <bool Delta>
+size_t encode(const uint32_t *values, size_t count, uint32_t previous, std::vector<uint8_t> &out) {
+    size_t start = out.size();
+    size_t controlBytes = (count + 3) / 4;
+    out.resize(start + controlBytes + 4 * count);
+    uint8_t *control = out.data() + start;
+    uint8_t *data = control + controlBytes;
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t value = Delta ? values[i] - previous : values[i];
+        previous = values[i];
+        unsigned code = byteCode(value);
+        if (i % 4 == 0)
+            control[i / 4] = 0;
+        control[i / 4] |= static_cast<uint8_t>(code << (2 * (i % 4)));
+        for (unsigned b = 0; b <= code; ++b)
+            *data++ = static_cast<uint8_t>(value >> (8 * b));
+    }
+    out.resize(data - out.data());
+    return out.size() - start;
+}
+
+#if defined(STREAMVBYTE_SSSE3)
+bool haveSsse3() {
+#if defined(__SSSE3__)
+    return true;
+#else
+    static const bool supported = [] {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("ssse3") != 0;
+    }();
+    return supported;
+#endif
+}
+
+// four values per control byte, as long as a full 16 byte load stays inside
+// the buffer. for deltas the four are prefix summed in register. returns how
+// many values it decoded, data and previous are moved past them.
+template <bool Delta>
+__attribute__((target("ssse3")))
+size_t decodeShuffled(const uint8_t *control, const uint8_t *&data, const uint8_t *end, size_t count,
+                      uint32_t &previous, uint32_t *values) {
+    // a local copy, the stores could alias data and it would be reloaded every time
+    const uint8_t *at = data;
+    size_t i = 0;
+    __m128i carry = _mm_set1_epi32(static_cast<int>(previous));
+    for (; i + 4 <= count && end - at >= 16; i += 4) {
+        uint8_t code = control[i / 4];
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(at));
+        __m128i shuffle = _mm_load_si128(reinterpret_cast<const __m128i *>(decodeTables.shuffle[code].data()));
+        __m128i four = _mm_shuffle_epi8(bytes, shuffle);
+        if constexpr (Delta) {
+            four = _mm_add_epi32(four, _mm_slli_si128(four, 4));
+            four = _mm_add_epi32(four, _mm_slli_si128(four, 8));
+            four = _mm_add_epi32(four, carry);
+            carry = _mm_shuffle_epi32(four, 0xFF);
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(values + i), four);
+        at += decodeTables.length[code];
+    }
+    data = at;
+    if (i > 0)
+        previous = values[i - 1];
+    return i;
+}
+#endif
+
+template <bool Delta>
+size_t decode(const uint8_t *in, const uint8_t *end, size_t count, uint32_t previous, uint32_t *values) {
+    const uint8_t *control = in;
+    const uint8_t *data = in + (count + 3) / 4;
+    size_t i = 0;
+
+#if defined(STREAMVBYTE_SSSE3)
+    if (haveSsse3())
+        i = decodeShuffled<Delta>(control, data, end, count, previous, values);
+#else
+    (void) end;
+#endif
+
+    for (; i < count; ++i) {
+        unsigned code = (control[i / 4] >> (2 * (i % 4))) & 3;
+        uint32_t value = 0;
+        for (unsigned b = 0; b <= code; ++b)
+            value |= uint32_t(*data++) << (8 * b);
+        if constexpr (Delta)
+            value += previous;
+        values[i] = previous = value;
+    }
+    return data - in;
+}
+
+}
+
+size_t streamVByteEncode(const uint32_t *values, size_t count, std::vector<uint8_t> &out) {
+    return encode<false>(values, count, 0, out);
+}
+
+size_t streamVByteEncodeDelta(const uint32_t *values, size_t count, uint32_t previous, std::vector<uint8_t> &out) {
+    return encode<true>(values, count, previous, out);
+}
+
+size_t streamVByteDecode(const uint8_t *in, const uint8_t *end, size_t count, uint32_t *values) {
+    return decode<false>(in, end, count, 0, values);
+}
+
+size_t streamVByteDecodeDelta(const uint8_t *in, const uint8_t *end, size_t count, uint32_t previous,
+                              uint32_t *values) {
+    return decode<true>(in, end, count, previous, values);
+}
+
+size_t streamVByteSkip(const uint8_t *in, size_t count) {
+    size_t bytes = (count + 3) / 4;
+    for (size_t i = 0; i < count / 4; ++i)
+        bytes += decodeTables.length[in[i]];
+    // the last control byte may be short, its unused codes don't count
+    for (size_t i = count / 4 * 4; i < count; ++i)
+        bytes += ((in[i / 4] >> (2 * (i % 4))) & 3) + 1;
+    return bytes;
+}
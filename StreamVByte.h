@@ -0,0 +1,31 @@
+//
+// StreamVByte integer codec (Lemire, Kurz and Rupp) for posting lists. A
+// value takes 1 to 4 bytes, and the lengths are kept apart from the data as
+// 2 bit codes, four to a control byte, so a decoder can expand four values
+// at once with one byte shuffle.
+//
+
+#ifndef STREAMVBYTE_H
+#define STREAMVBYTE_H
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// appends count values to out: (count + 3) / 4 control bytes, then the data.
+// returns the bytes written.
+size_t streamVByteEncode(const uint32_t *values, size_t count, std::vector<uint8_t> &out);
+// the same for an ascending list, each value stored as its difference from
+// the one before (the first from previous)
+size_t streamVByteEncodeDelta(const uint32_t *values, size_t count, uint32_t previous, std::vector<uint8_t> &out);
+
+// decodes count values from in, where the readable bytes stop at end.
+// returns the bytes read.
+size_t streamVByteDecode(const uint8_t *in, const uint8_t *end, size_t count, uint32_t *values);
+size_t streamVByteDecodeDelta(const uint8_t *in, const uint8_t *end, size_t count, uint32_t previous,
+                              uint32_t *values);
+
+// the bytes count values starting at in take up, read off the control
+// bytes without decoding anything
+size_t streamVByteSkip(const uint8_t *in, size_t count);
+
+#endif //STREAMVBYTE_H
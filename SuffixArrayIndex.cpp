@@ -0,0 +1,238 @@
+//
+// Substring (infix) search over song titles with a suffix array, so "love"
+// also finds "Crazy in Love". The normalized titles are joined into one
+// text, every suffix of it is sorted (SA-IS, linear time), and the matches
+// for a query are the run of suffixes that start with it.
+//
+
+#include "SuffixArrayIndex.h"
+#include "TitleKey.h"
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <numeric>
+
+namespace {
+
+constexpr uint32_t none = UINT32_MAX;
+
+// SA-IS (Nong, Zhang and Chan). s holds symbols 0..upper. each suffix is S
+// type if it sorts before the next one, else L type; the leftmost S of each
+// run (LMS) is sorted first, and one induced pass left to right places the L
+// suffixes and one right to left places the S ones. if two LMS substrings
+// are equal the LMS order is not settled yet, so their names are sorted
+// recursively and the induction is run again with the real order.
+std::vector<uint32_t> suffixArray(const std::vector<uint32_t> &s, uint32_t upper) {
+    size_t n = s.size();
+    if (n == 0)
+        return {};
+    if (n == 1)
+        return {0};
+    if (n == 2)
+        return s[0] < s[1] ? std::vector<uint32_t> {0, 1} : std::vector<uint32_t> {1, 0};
+
+    std::vector<bool> sType(n);
+    for (size_t i = n - 1; i-- > 0;)
+        sType[i] = s[i] == s[i + 1] ? sType[i + 1] : s[i] < s[i + 1];
+
+    // where each symbol's L and S buckets begin
+    std::vector<uint32_t> startL(upper + 2), startS(upper + 1);
+    for (size_t i = 0; i < n; ++i) {
+        if (!sType[i])
+            ++startS[s[i]];
+        else
+            ++startL[s[i] + 1];
+    }
+    for (uint32_t c = 0; c <= upper; ++c) {
+        startS[c] += startL[c];
+        if (c < upper)
+            startL[c + 1] += startS[c];
+    }
+
+    std::vector<uint32_t> sa(n);
+    std::vector<uint32_t> bucket(upper + 2);
+    auto induce = [&](const std::vector<uint32_t> &lms) {
+        std::fill(sa.begin(), sa.end(), none);
+        std::copy(startS.begin(), startS.end(), bucket.begin());
+        for (uint32_t p : lms)
+            sa[bucket[s[p]]++] = p;
+        std::copy(startL.begin(), startL.end(), bucket.begin());
+        sa[bucket[s[n - 1]]++] = static_cast<uint32_t>(n - 1);
+        for (size_t i = 0; i < n; ++i) {
+            uint32_t p = sa[i];
+            if (p != none && p > 0 && !sType[p - 1])
+                sa[bucket[s[p - 1]]++] = p - 1;
+        }
+        std::copy(startL.begin(), startL.end(), bucket.begin());
+        for (size_t i = n; i-- > 0;) {
+            uint32_t p = sa[i];
+            if (p != none && p > 0 && sType[p - 1])
+                sa[--bucket[s[p - 1] + 1]] = p - 1;
+        }
+    };
+
+    std::vector<uint32_t> lmsIndex(n, none);
+    std::vector<uint32_t> lms;
+    for (size_t i = 1; i < n; ++i) {
+        if (!sType[i - 1] && sType[i]) {
+            lmsIndex[i] = static_cast<uint32_t>(lms.size());
+            lms.push_back(static_cast<uint32_t>(i));
+        }
+    }
+    induce(lms);
+    if (lms.empty())
+        return sa;
+
+    // name the LMS substrings in the order the first pass left them
+    size_t m = lms.size();
+    std::vector<uint32_t> sortedLms;
+    sortedLms.reserve(m);
+    for (uint32_t p : sa) {
+        if (p != none && lmsIndex[p] != none)
+            sortedLms.push_back(p);
+    }
+    std::vector<uint32_t> names(m);
+    uint32_t name = 0;
+    names[lmsIndex[sortedLms[0]]] = 0;
+    for (size_t i = 1; i < m; ++i) {
+        size_t l = sortedLms[i - 1], r = sortedLms[i];
+        size_t endL = lmsIndex[l] + 1 < m ? lms[lmsIndex[l] + 1] : n;
+        size_t endR = lmsIndex[r] + 1 < m ? lms[lmsIndex[r] + 1] : n;
+        bool same = endL - l == endR - r;
+        if (same) {
+            while (l < endL && s[l] == s[r]) {
+                ++l;
+                ++r;
+            }
+            same = l != n && s[l] == s[r];
+        }
+        if (!same)
+            ++name;
+        names[lmsIndex[sortedLms[i]]] = name;
+    }
+
+    std::vector<uint32_t> namesOrder = suffixArray(names, name);
+    for (size_t i = 0; i < m; ++i)
+        sortedLms[i] = lms[namesOrder[i]];
+    induce(sortedLms);
+    return sa;
+}
+
+}
+
+void SuffixArrayIndex::build(const std::vector<Songs> &songs) {
+    text.clear();
+    for (const Songs &song : songs) {
+        text += titleKey(song.name);
+        text += '\0';
+    }
+    text.shrink_to_fit();
+    songCount = songs.size();
+
+    separators.assign(text.size() / 64 + 1, 0);
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (text[i] == '\0')
+            separators[i / 64] |= uint64_t(1) << (i % 64);
+    }
+    separatorsBefore.resize(separators.size());
+    uint32_t before = 0;
+    for (size_t word = 0; word < separators.size(); ++word) {
+        separatorsBefore[word] = before;
+        before += std::popcount(separators[word]);
+    }
+
+    std::vector<uint32_t> symbols(text.size());
+    for (size_t i = 0; i < text.size(); ++i)
+        symbols[i] = static_cast<uint8_t>(text[i]);
+    suffixes = suffixArray(symbols, 255);
+    symbols = {};
+
+    // Kasai: going through the suffixes in text order, the lcp with the
+    // suffix before it in sorted order drops by at most one each step
+    size_t n = text.size();
+    std::vector<uint32_t> rank(n);
+    for (size_t i = 0; i < n; ++i)
+        rank[suffixes[i]] = static_cast<uint32_t>(i);
+    lcp.assign(n, 0);
+    size_t h = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (rank[i] == 0) {
+            h = 0;
+            continue;
+        }
+        size_t j = suffixes[rank[i] - 1];
+        while (i + h < n && j + h < n && text[i + h] == text[j + h])
+            ++h;
+        lcp[rank[i]] = static_cast<uint32_t>(h);
+        if (h)
+            --h;
+    }
+}
+
+uint32_t SuffixArrayIndex::songAt(uint32_t position) const {
+    uint64_t below = (uint64_t(1) << (position % 64)) - 1;
+    return separatorsBefore[position / 64] + std::popcount(separators[position / 64] & below);
+}
+
+// every song with key somewhere in its title, in id order and each once
+void SuffixArrayIndex::matchingSongs(std::string_view key, std::vector<uint32_t> &songs) const {
+    if (key.empty()) {
+        songs.resize(songCount);
+        std::iota(songs.begin(), songs.end(), 0u);
+        return;
+    }
+    // first suffix not below key, O(m log n) character compares
+    std::string_view all(text);
+    auto first = std::partition_point(suffixes.begin(), suffixes.end(), [&](uint32_t position) {
+        return all.substr(position, key.size()) < key;
+    });
+    if (first == suffixes.end() || !all.substr(*first).starts_with(key))
+        return;
+    // the rest of the run shares at least the key's length with the one before
+    size_t begin = first - suffixes.begin();
+    size_t end = begin + 1;
+    while (end < suffixes.size() && lcp[end] >= key.size())
+        ++end;
+
+    // a title can hold the key more than once. a few hits are sorted and the
+    // repeats dropped, only a run big enough to pay for a pass over every
+    // song gets a bitmap, which reads back in id order without sorting
+    size_t start = songs.size();
+    if (end - begin < (songCount + 63) / 64) {
+        for (size_t i = begin; i < end; ++i)
+            songs.push_back(songAt(suffixes[i]));
+        std::sort(songs.begin() + static_cast<ptrdiff_t>(start), songs.end());
+        songs.erase(std::unique(songs.begin() + static_cast<ptrdiff_t>(start), songs.end()), songs.end());
+        return;
+    }
+    std::vector<uint64_t> seen((songCount + 63) / 64);
+    for (size_t i = begin; i < end; ++i) {
+        uint32_t song = songAt(suffixes[i]);
+        seen[song / 64] |= uint64_t(1) << (song % 64);
+    }
+    for (size_t word = 0; word < seen.size(); ++word) {
+        for (uint64_t bits = seen[word]; bits; bits &= bits - 1)
+            songs.push_back(static_cast<uint32_t>(word * 64 + std::countr_zero(bits)));
+    }
+}
+
+void SuffixArrayIndex::search(std::string_view query, std::vector<uint32_t> &results, size_t limit,
+                              size_t offset) const {
+    std::vector<uint32_t> songs;
+    matchingSongs(titleKey(query), songs);
+    if (offset >= songs.size())
+        return;
+    size_t end = offset + std::min(limit, songs.size() - offset);
+    results.insert(results.end(), songs.begin() + offset, songs.begin() + end);
+}
+
+size_t SuffixArrayIndex::count(std::string_view query) const {
+    std::vector<uint32_t> songs;
+    matchingSongs(titleKey(query), songs);
+    return songs.size();
+}
+
+size_t SuffixArrayIndex::memoryUsage() const {
+    return text.capacity() + (suffixes.capacity() + lcp.capacity() + separatorsBefore.capacity()) * sizeof(uint32_t)
+         + separators.capacity() * sizeof(uint64_t);
+}
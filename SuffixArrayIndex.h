@@ -0,0 +1,48 @@
+//
+// Substring (infix) search over song titles with a suffix array, so "love"
+// also finds "Crazy in Love". The normalized titles are joined into one
+// text, every suffix of it is sorted (SA-IS, linear time), and the matches
+// for a query are the run of suffixes that start with it.
+//
+
+#ifndef SUFFIXARRAYINDEX_H
+#define SUFFIXARRAYINDEX_H
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Songs.h"
+
+class SuffixArrayIndex {
+public:
+    // replaces whatever was there with an index over songs
+    void build(const std::vector<Songs> &songs);
+
+    // appends the ids of songs whose normalized title contains the query's,
+    // each once and in id order, skipping offset of them and stopping after
+    // limit. an empty query matches every song.
+    void search(std::string_view query, std::vector<uint32_t> &results,
+                size_t limit = SIZE_MAX, size_t offset = 0) const;
+    // how many songs search() would return with no limit
+    size_t count(std::string_view query) const;
+
+    size_t memoryUsage() const;
+
+private:
+    void matchingSongs(std::string_view key, std::vector<uint32_t> &songs) const;
+    uint32_t songAt(uint32_t position) const;
+
+    // every title key followed by a 0 byte, which no key contains, so no
+    // match can run from one title into the next
+    std::string text;
+    std::vector<uint32_t> suffixes;   // text positions in suffix order
+    std::vector<uint32_t> lcp;        // lcp[i] is the common prefix of suffixes i - 1 and i
+    // a bit per text byte, set on the 0 after each title. the song a text
+    // position belongs to is the number of set bits before it, and
+    // separatorsBefore holds that count at every 64 bit word boundary.
+    std::vector<uint64_t> separators;
+    std::vector<uint32_t> separatorsBefore;
+    size_t songCount = 0;
+};
+
+#endif //SUFFIXARRAYINDEX_H
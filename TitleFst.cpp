@@ -0,0 +1,290 @@
+//
+// Minimal acyclic finite state transducer from normalized titles to song id
+// ranges. Read-only: built once from the sorted keys, saved to a file, and
+// queried straight out of an mmap so several searchers share one copy.
+//
+
+#include "TitleFst.h"
+#include "Checksum.h"
+#include "TitleKey.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <unordered_map>
+
+namespace {
+
+constexpr char fstMagic[8] = {'S', 'O', 'N', 'G', 'F', 'S', 'T', '2'};
+
+struct FstHeader {
+    char magic[8];
+    uint64_t states;
+    uint64_t arcs;
+    uint64_t keyCount;
+    uint64_t songCount;
+    uint64_t root;
+    uint64_t checksum; // of the arrays after the header
+};
+
+using ArrayBytes = std::array<std::string_view, 4>;
+
+// the arrays in file order, as bytes
+template <typename State, typename Arc>
+ArrayBytes arrayBytes(const State *states, const Arc *arcs, const uint32_t *keyStarts, const uint32_t *songIds,
+                      uint64_t stateCount, uint64_t arcCount, uint64_t keyCount, uint64_t songCount) {
+    auto bytes = [](const auto *array, uint64_t count) {
+        return std::string_view(reinterpret_cast<const char *>(array), count * sizeof(*array));
+    };
+    return {bytes(states, stateCount), bytes(arcs, arcCount), bytes(keyStarts, keyCount + 1),
+            bytes(songIds, songCount)};
+}
+
+// each array is hashed on its own and the results chained, as in the
+// double-array trie's file
+uint64_t arraysChecksum(const ArrayBytes &arrays) {
+    uint64_t hash = checksumStart;
+    for (std::string_view array : arrays)
+        hash = checksum(array.data(), array.size(), hash);
+    return hash;
+}
+
+// a state still on the path of the last key, its last arc is not frozen yet
+struct Unfinished {
+    bool final = false;
+    std::vector<std::pair<uint8_t, uint32_t>> arcs;
+};
+
+}
+
+void TitleFst::point() {
+    stateData = ownedStates.data();
+    arcData = ownedArcs.data();
+    keyStarts = ownedKeyStarts.data();
+    songIds = ownedSongIds.data();
+    states = ownedStates.size();
+    arcs = ownedArcs.size();
+}
+
+void TitleFst::build(const std::vector<Songs> &songs) {
+    mapping = MappedFile();
+
+    // group the songs by key, in key order, keeping table order within a key
+    std::vector<std::string> keyOf(songs.size());
+    for (size_t i = 0; i < songs.size(); ++i)
+        keyOf[i] = titleKey(songs[i].name);
+    std::vector<uint32_t> order(songs.size());
+    std::iota(order.begin(), order.end(), 0u);
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return keyOf[a] < keyOf[b]; });
+
+    ownedStates.clear();
+    ownedArcs.clear();
+    ownedKeyStarts.clear();
+    ownedSongIds = order;
+
+    // equal states (same finality, same labelled arcs to the same frozen
+    // states) are stored once, which is what merges the shared suffixes
+    std::unordered_map<std::string, uint32_t> registry;
+    std::string signature;
+    auto freeze = [&](const Unfinished &node) {
+        signature.assign(1, node.final ? '1' : '0');
+        for (auto [label, target] : node.arcs) {
+            signature += static_cast<char>(label);
+            signature.append(reinterpret_cast<const char *>(&target), sizeof(target));
+        }
+        auto found = registry.find(signature);
+        if (found != registry.end())
+            return found->second;
+
+        State state {static_cast<uint32_t>(ownedArcs.size()), static_cast<uint32_t>(node.arcs.size()), 0,
+                     node.final ? 1u : 0u};
+        uint32_t below = state.final;
+        for (auto [label, target] : node.arcs) {
+            ownedArcs.push_back({label, target, below});
+            below += ownedStates[target].keyCount;
+        }
+        state.keyCount = below;
+        auto id = static_cast<uint32_t>(ownedStates.size());
+        ownedStates.push_back(state);
+        registry.emplace(signature, id);
+        return id;
+    };
+
+    // unfinished[i] is the state reached by the first i bytes of the last key
+    std::vector<Unfinished> unfinished(1);
+    auto freezeDownTo = [&](size_t depth) {
+        while (unfinished.size() > depth + 1) {
+            uint32_t id = freeze(unfinished.back());
+            unfinished.pop_back();
+            unfinished.back().arcs.back().second = id;
+        }
+    };
+
+    // one pass over the keys in sorted order
+    std::string previous;
+    for (uint32_t i = 0; i < order.size(); ++i) {
+        const std::string &key = keyOf[order[i]];
+        if (i > 0 && key == previous)
+            continue;
+        ownedKeyStarts.push_back(i);
+
+        size_t common = std::mismatch(previous.begin(), previous.end(), key.begin(), key.end()).first - previous.begin();
+        if (i == 0)
+            common = 0;
+        freezeDownTo(common);
+        for (size_t depth = common; depth < key.size(); ++depth) {
+            unfinished.back().arcs.emplace_back(static_cast<uint8_t>(key[depth]), 0);
+            unfinished.emplace_back();
+        }
+        unfinished.back().final = true;
+        previous = key;
+    }
+    freezeDownTo(0);
+    root = freeze(unfinished[0]);
+    ownedKeyStarts.push_back(static_cast<uint32_t>(order.size()));
+
+    keyCount = ownedKeyStarts.size() - 1;
+    songCount = ownedSongIds.size();
+    point();
+}
+
+// ranks [first, last) of the keys that start with query
+bool TitleFst::keyRange(std::string_view query, uint32_t &first, uint32_t &last) const {
+    if (states == 0)
+        return false;
+    std::string key = titleKey(query);
+    uint32_t state = root;
+    uint32_t rank = 0;
+    for (char c : key) {
+        const State &current = stateData[state];
+        const Arc *begin = arcData + current.firstArc;
+        const Arc *end = begin + current.arcCount;
+        auto label = static_cast<uint32_t>(static_cast<unsigned char>(c));
+        const Arc *arc = std::lower_bound(begin, end, label, [](const Arc &a, uint32_t l) { return a.label < l; });
+        if (arc == end || arc->label != label)
+            return false;
+        rank += arc->output;
+        state = arc->target;
+    }
+    // outputs along a bad path could add up past the keys, or wrap
+    if (rank > keyCount || stateData[state].keyCount > keyCount - rank)
+        return false;
+    first = rank;
+    last = rank + stateData[state].keyCount;
+    return true;
+}
+
+void TitleFst::search(std::string_view query, std::vector<uint32_t> &results, size_t limit, size_t offset) const {
+    uint32_t first;
+    uint32_t last;
+    if (!keyRange(query, first, last))
+        return;
+    // the songs of consecutive keys are consecutive, so this is one slice
+    size_t begin = std::min<size_t>(keyStarts[first] + offset, keyStarts[last]);
+    size_t end = std::min<size_t>(keyStarts[last], songCount);
+    if (end - std::min(begin, end) > limit)
+        end = begin + limit;
+    for (size_t i = begin; i < end; ++i)
+        results.push_back(songIds[i]);
+}
+
+size_t TitleFst::count(std::string_view query) const {
+    uint32_t first;
+    uint32_t last;
+    if (!keyRange(query, first, last))
+        return 0;
+    return keyStarts[last] - keyStarts[first];
+}
+
+size_t TitleFst::memoryUsage() const {
+    return states * sizeof(State) + arcs * sizeof(Arc) + (states ? keyCount + 1 : 0) * sizeof(uint32_t)
+         + songCount * sizeof(uint32_t);
+}
+
+bool TitleFst::save(const std::string &fileName) const {
+    std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        std::cerr << "Error opening file " << fileName << std::endl;
+        return false;
+    }
+    FstHeader header {};
+    std::memcpy(header.magic, fstMagic, sizeof(header.magic));
+    header.states = states;
+    header.arcs = arcs;
+    header.keyCount = keyCount;
+    header.songCount = songCount;
+    header.root = root;
+    ArrayBytes arrays = arrayBytes(stateData, arcData, keyStarts, songIds, states, arcs, keyCount, songCount);
+    header.checksum = arraysChecksum(arrays);
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    for (std::string_view array : arrays)
+        file.write(array.data(), static_cast<std::streamsize>(array.size()));
+    return static_cast<bool>(file);
+}
+
+bool TitleFst::load(const std::string &fileName) {
+    MappedFile file(fileName, MappedFile::Access::Random);
+    if (!file.isOpen() || file.size() < sizeof(FstHeader))
+        return false;
+    FstHeader header {};
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, fstMagic, sizeof(header.magic)) != 0)
+        return false;
+    // every count is a uint32_t index, so the sums below can't overflow
+    if (header.states > UINT32_MAX || header.arcs > UINT32_MAX || header.keyCount >= UINT32_MAX
+        || header.songCount > UINT32_MAX)
+        return false;
+    uint64_t expected = sizeof(header) + header.states * sizeof(State) + header.arcs * sizeof(Arc)
+                      + (header.keyCount + 1) * sizeof(uint32_t) + header.songCount * sizeof(uint32_t);
+    if (expected != file.size() || header.root >= header.states)
+        return false;
+
+    // the header is 56 bytes and every array is made of 4 byte words, so
+    // they can be used in place
+    auto loadedStates = reinterpret_cast<const State *>(file.data() + sizeof(header));
+    auto loadedArcs = reinterpret_cast<const Arc *>(loadedStates + header.states);
+    auto loadedKeyStarts = reinterpret_cast<const uint32_t *>(loadedArcs + header.arcs);
+    const uint32_t *loadedSongIds = loadedKeyStarts + header.keyCount + 1;
+    if (arraysChecksum(arrayBytes(loadedStates, loadedArcs, loadedKeyStarts, loadedSongIds, header.states,
+                                  header.arcs, header.keyCount, header.songCount))
+        != header.checksum) {
+        std::cerr << "Index " << fileName << " is corrupt, ignoring it" << std::endl;
+        return false;
+    }
+    // queries follow these without checking, so they have to stay in range
+    // even for a file that was written wrong rather than damaged
+    for (uint64_t state = 0; state < header.states; ++state) {
+        const State &current = loadedStates[state];
+        if (current.firstArc > header.arcs || current.arcCount > header.arcs - current.firstArc
+            || current.keyCount > header.keyCount)
+            return false;
+    }
+    for (uint64_t arc = 0; arc < header.arcs; ++arc) {
+        if (loadedArcs[arc].target >= header.states || loadedArcs[arc].output > header.keyCount)
+            return false;
+    }
+    for (uint64_t key = 0; key < header.keyCount; ++key) {
+        if (loadedKeyStarts[key] > loadedKeyStarts[key + 1])
+            return false;
+    }
+    if (loadedKeyStarts[header.keyCount] > header.songCount)
+        return false;
+
+    ownedStates.clear();
+    ownedArcs.clear();
+    ownedKeyStarts.clear();
+    ownedSongIds.clear();
+    states = header.states;
+    arcs = header.arcs;
+    keyCount = header.keyCount;
+    songCount = header.songCount;
+    root = static_cast<uint32_t>(header.root);
+    stateData = loadedStates;
+    arcData = loadedArcs;
+    keyStarts = loadedKeyStarts;
+    songIds = loadedSongIds;
+    mapping = std::move(file);
+    return true;
+}
@@ -0,0 +1,75 @@
+//
+// Minimal acyclic finite state transducer from normalized titles to song id
+// ranges. Read-only: built once from the sorted keys, saved to a file, and
+// queried straight out of an mmap so several searchers share one copy.
+//
+
+#ifndef TITLEFST_H
+#define TITLEFST_H
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "MappedFile.h"
+#include "Songs.h"
+
+class TitleFst {
+public:
+    // replaces whatever was there with an index over songs
+    void build(const std::vector<Songs> &songs);
+
+    // same as Trie::search: ids of songs whose title starts with query, in the
+    // same order, skipping offset matches and stopping after limit
+    void search(std::string_view query, std::vector<uint32_t> &results,
+                size_t limit = SIZE_MAX, size_t offset = 0) const;
+    // how many songs search() would return with no limit
+    size_t count(std::string_view query) const;
+
+    size_t stateCount() const { return states; }
+    size_t arcCount() const { return arcs; }
+    // bytes of the arrays, whether built or mapped
+    size_t memoryUsage() const;
+
+    bool save(const std::string &fileName) const;
+    // maps fileName and answers queries straight out of the mapping
+    bool load(const std::string &fileName);
+
+private:
+    // keyCount is how many keys the state accepts from here on, and an arc's
+    // output is how many of them sort before the arc's label, so the outputs
+    // along a path add up to the key's rank among all keys
+    struct State {
+        uint32_t firstArc;
+        uint32_t arcCount;
+        uint32_t keyCount;
+        uint32_t final;
+    };
+    struct Arc {
+        uint32_t label;
+        uint32_t target;
+        uint32_t output;
+    };
+
+    bool keyRange(std::string_view query, uint32_t &first, uint32_t &last) const;
+    void point();
+
+    // owned arrays after build(), empty after load()
+    std::vector<State> ownedStates;
+    std::vector<Arc> ownedArcs;
+    std::vector<uint32_t> ownedKeyStarts;
+    std::vector<uint32_t> ownedSongIds;
+    MappedFile mapping;
+
+    // a key of rank r has songs songIds[keyStarts[r] .. keyStarts[r + 1])
+    const State *stateData = nullptr;
+    const Arc *arcData = nullptr;
+    const uint32_t *keyStarts = nullptr;
+    const uint32_t *songIds = nullptr;
+    size_t states = 0;
+    size_t arcs = 0;
+    size_t keyCount = 0;
+    size_t songCount = 0;
+    uint32_t root = 0;
+};
+
+#endif //TITLEFST_H
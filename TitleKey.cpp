@@ -0,0 +1,211 @@
+//
+// Normalized form of a song title that the indexes are keyed on
+//
+
+#include "TitleKey.h"
+#include <array>
+
+namespace {
+
+// code points below this go through the tables, everything above is kept as is
+constexpr char32_t tableEnd = 0x500;
+constexpr char32_t dropped = 0;
+
+// simple case folding for Basic Latin, Latin-1, Latin Extended-A, Greek and
+// Cyrillic, with 0 for the code points that are not part of a key
+constexpr std::array<char32_t, tableEnd> foldTable = [] {
+    std::array<char32_t, tableEnd> fold {};
+    for (char32_t c = 0; c < tableEnd; ++c)
+        fold[c] = c;
+
+    for (char32_t c = 0; c < 0x80; ++c) {
+        bool digit = c >= '0' && c <= '9';
+        bool lower = c >= 'a' && c <= 'z';
+        bool upper = c >= 'A' && c <= 'Z';
+        fold[c] = upper ? c + 0x20 : (digit || lower) ? c : dropped;
+    }
+    // Latin-1 controls, punctuation and symbols, and the two math signs
+    for (char32_t c = 0x80; c < 0xC0; ++c)
+        fold[c] = dropped;
+    fold[0xD7] = dropped;
+    fold[0xF7] = dropped;
+    for (char32_t c = 0xC0; c <= 0xDE; ++c) {
+        if (c != 0xD7)
+            fold[c] = c + 0x20;
+    }
+
+    // Latin Extended-A is mostly upper/lower pairs, with a few odd ones out
+    for (char32_t c = 0x100; c < 0x138; c += 2)
+        fold[c] = c + 1;
+    fold[0x130] = 'i';
+    fold[0x131] = 0x131;
+    for (char32_t c = 0x139; c < 0x149; c += 2)
+        fold[c] = c + 1;
+    for (char32_t c = 0x14A; c < 0x178; c += 2)
+        fold[c] = c + 1;
+    fold[0x178] = 0xFF;
+    for (char32_t c = 0x179; c < 0x17F; c += 2)
+        fold[c] = c + 1;
+    fold[0x17F] = 's';
+
+    // Greek
+    for (char32_t c = 0x391; c <= 0x3A9; ++c) {
+        if (c != 0x3A2)
+            fold[c] = c + 0x20;
+    }
+    fold[0x386] = 0x3AC;
+    fold[0x388] = 0x3AD;
+    fold[0x389] = 0x3AE;
+    fold[0x38A] = 0x3AF;
+    fold[0x38C] = 0x3CC;
+    fold[0x38E] = 0x3CD;
+    fold[0x38F] = 0x3CE;
+    fold[0x3C2] = 0x3C3; // final sigma
+
+    // Cyrillic
+    for (char32_t c = 0x400; c < 0x410; ++c)
+        fold[c] = c + 0x50;
+    for (char32_t c = 0x410; c < 0x430; ++c)
+        fold[c] = c + 0x20;
+    for (char32_t c = 0x460; c < 0x482; c += 2)
+        fold[c] = c + 1;
+    for (char32_t c = 0x48A; c < 0x4C0; c += 2)
+        fold[c] = c + 1;
+    fold[0x4C0] = 0x4CF; // palochka, its lower case is at the end of the run
+    for (char32_t c = 0x4C1; c < 0x4CF; c += 2)
+        fold[c] = c + 1;
+    for (char32_t c = 0x4D0; c < 0x500; c += 2)
+        fold[c] = c + 1;
+    return fold;
+}();
+
+bool isPunctuation(char32_t c) {
+    return (c >= 0x2000 && c <= 0x206F)  // general punctuation, fancy spaces and quotes
+        || (c >= 0x3000 && c <= 0x303F)  // CJK punctuation
+        || (c >= 0xFE30 && c <= 0xFE4F)
+        || (c >= 0xFF01 && c <= 0xFF0F)  // full width ascii punctuation
+        || c == 0xFEFF;                  // byte order mark
+}
+
+// decodes one code point at text[pos], moving pos past it. returns
+// UINT32_MAX (and skips one byte) for anything that is not valid UTF-8.
+char32_t decode(std::string_view text, size_t &pos) {
+    auto lead = static_cast<unsigned char>(text[pos++]);
+    if (lead < 0x80)
+        return lead;
+
+    size_t extra;
+    char32_t code;
+    if ((lead & 0xE0) == 0xC0) {
+        extra = 1;
+        code = lead & 0x1F;
+    } else if ((lead & 0xF0) == 0xE0) {
+        extra = 2;
+        code = lead & 0x0F;
+    } else if ((lead & 0xF8) == 0xF0) {
+        extra = 3;
+        code = lead & 0x07;
+    } else {
+        return UINT32_MAX;
+    }
+    if (pos + extra > text.size())
+        return UINT32_MAX;
+    for (size_t i = 0; i < extra; ++i) {
+        auto next = static_cast<unsigned char>(text[pos + i]);
+        if ((next & 0xC0) != 0x80)
+            return UINT32_MAX;
+        code = (code << 6) | (next & 0x3F);
+    }
+    // overlong forms and surrogates are not valid either
+    constexpr char32_t smallest[] = {0, 0x80, 0x800, 0x10000};
+    if (code < smallest[extra] || code > 0x10FFFF || (code >= 0xD800 && code <= 0xDFFF))
+        return UINT32_MAX;
+    pos += extra;
+    return code;
+}
+
+void encode(char32_t code, std::string &out) {
+    if (code < 0x80) {
+        out += static_cast<char>(code);
+    } else if (code < 0x800) {
+        out += static_cast<char>(0xC0 | (code >> 6));
+        out += static_cast<char>(0x80 | (code & 0x3F));
+    } else if (code < 0x10000) {
+        out += static_cast<char>(0xE0 | (code >> 12));
+        out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (code & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (code >> 18));
+        out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (code & 0x3F));
+    }
+}
+
+}
+
+std::string titleKey(std::string_view title) {
+    std::string key;
+    key.reserve(title.size());
+    size_t pos = 0;
+    while (pos < title.size()) {
+        // plain ascii is by far the common case, skip the decoder for it
+        auto byte = static_cast<unsigned char>(title[pos]);
+        if (byte < 0x80) {
+            ++pos;
+            if (char32_t folded = foldTable[byte])
+                key += static_cast<char>(folded);
+            continue;
+        }
+
+        char32_t code = decode(title, pos);
+        if (code == UINT32_MAX)
+            continue;
+        if (code < tableEnd) {
+            if (char32_t folded = foldTable[code])
+                encode(folded, key);
+        } else if (!isPunctuation(code)) {
+            encode(code, key);
+        }
+    }
+    return key;
+}
+
+bool nextWord(std::string_view text, size_t &pos, std::string &word) {
+    word.clear();
+    while (pos < text.size()) {
+        auto byte = static_cast<unsigned char>(text[pos]);
+        if (byte < 0x80) {
+            ++pos;
+            if (char32_t folded = foldTable[byte])
+                word += static_cast<char>(folded);
+            else if (byte != '\'' && !word.empty())
+                return true;
+            continue;
+        }
+
+        char32_t code = decode(text, pos);
+        char32_t folded = code == UINT32_MAX ? dropped
+                        : code < tableEnd    ? foldTable[code]
+                        : isPunctuation(code) ? dropped
+                                              : code;
+        if (folded) {
+            encode(folded, word);
+        } else if (code != 0x2019 && !word.empty()) { // right single quote, the curly apostrophe
+            return true;
+        }
+    }
+    return !word.empty();
+}
+
+// drop trailing 0xff bytes and bump the last one left. (UTF-8 never has
+// 0xff, but the sorted indexes should not have to know that.)
+bool keySuccessor(std::string_view prefix, std::string &successor) {
+    successor.assign(prefix);
+    while (!successor.empty() && static_cast<unsigned char>(successor.back()) == 0xFF)
+        successor.pop_back();
+    if (successor.empty())
+        return false;
+    ++successor.back();
+    return true;
+}
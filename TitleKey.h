@@ -0,0 +1,28 @@
+//
+// Normalized form of a song title that the indexes are keyed on
+//
+
+#ifndef TITLEKEY_H
+#define TITLEKEY_H
+#include <string>
+#include <string_view>
+
+// the title decoded as UTF-8, case folded, with letters and digits kept and
+// spaces/punctuation dropped, then encoded back to UTF-8. so "Hello, Goodbye"
+// and "hellogoodbye" are the same key, "22" stays "22" and "BJÖRK" is "björk".
+// bytes that are not valid UTF-8 are dropped. there is no normalization:
+// combining marks are kept as they are, so "e" plus U+0301 is not the same
+// key as a precomposed "é".
+std::string titleKey(std::string_view title);
+
+// splits text (lyrics) into words keyed the same way: runs of letters and
+// digits, case folded. an apostrophe inside a word is dropped without
+// ending it, so "Don't" is "dont". puts the next word after pos in word and
+// moves pos past it, false once there are no words left.
+bool nextWord(std::string_view text, size_t &pos, std::string &word);
+
+// the least key past every key that starts with prefix, so the keys starting
+// with prefix are exactly [prefix, successor). false if there is no such key.
+bool keySuccessor(std::string_view prefix, std::string &successor);
+
+#endif //TITLEKEY_H
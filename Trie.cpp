@@ -0,0 +1,596 @@
+//
+// Prefix tree over song titles, used by the search box
+//
+
+#include "Trie.h"
+#include "Parallel.h"
+#include "TitleKey.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+namespace {
+
+constexpr size_t nodeWords = sizeof(TrieNode) / sizeof(uint32_t);
+static_assert(sizeof(TrieNode) % sizeof(uint32_t) == 0, "TrieNode is dumped as raw words");
+static_assert(std::is_trivially_copyable_v<TrieNode>, "TrieNode is dumped as raw words");
+constexpr size_t songWords = 2; // SongEntry is (song id, next)
+
+}
+
+Trie::Trie() {
+    nodes.emplace_back(); // root
+    parents.push_back(TrieNode::noSong);
+}
+
+void Trie::insert(std::string_view songName, uint32_t songId) {
+    // a second entry for the id would be left behind when erase() takes out
+    // the one songNodes points at, so the old one goes first
+    if (songId < songNodes.size() && songNodes[songId] != TrieNode::noSong)
+        erase(songId);
+    uint32_t node = insertKey(titleKey(songName), songId);
+    if (songNodes.size() <= songId)
+        songNodes.resize(songId + 1, TrieNode::noSong);
+    songNodes[songId] = node;
+}
+
+bool Trie::erase(uint32_t songId) {
+    if (songId >= songNodes.size() || songNodes[songId] == TrieNode::noSong)
+        return false;
+    uint32_t node = songNodes[songId];
+    songNodes[songId] = TrieNode::noSong;
+
+    // unlink the song from its node's list and put the entry on the free list
+    uint32_t previous = TrieNode::noSong;
+    uint32_t entry = nodes[node].firstSong;
+    while (songEntries[entry].songId != songId) {
+        previous = entry;
+        entry = songEntries[entry].next;
+    }
+    uint32_t next = songEntries[entry].next;
+    if (previous == TrieNode::noSong)
+        nodes[node].firstSong = next;
+    else
+        songEntries[previous].next = next;
+    if (nodes[node].lastSong == entry)
+        nodes[node].lastSong = previous;
+    songEntries[entry].next = freeSongEntries;
+    freeSongEntries = entry;
+
+    // a node with no songs and no children leads nowhere, free the chain of
+    // them up to the first node something else still needs
+    while (node != 0 && !nodes[node].isEndOfWord() && !nodes[node].firstChild) {
+        uint32_t parent = parents[node];
+        uint32_t *link = &nodes[parent].firstChild;
+        while (*link != node)
+            link = &nodes[*link].nextSibling;
+        *link = nodes[node].nextSibling;
+
+        nodes[node] = TrieNode();
+        nodes[node].nextSibling = freeNodes;
+        freeNodes = node;
+        parents[node] = TrieNode::noSong;
+        ++freeNodeCount;
+        node = parent;
+    }
+
+    topRanges.clear();
+    topEntries.clear();
+    return true;
+}
+
+bool Trie::update(uint32_t songId, std::string_view newName) {
+    if (!erase(songId))
+        return false;
+    insert(newName, songId);
+    return true;
+}
+
+// a node slot, from the free list when there is one
+uint32_t Trie::newNode() {
+    if (freeNodes) {
+        uint32_t node = freeNodes;
+        freeNodes = nodes[node].nextSibling;
+        nodes[node] = TrieNode();
+        --freeNodeCount;
+        return node;
+    }
+    nodes.emplace_back();
+    parents.push_back(TrieNode::noSong);
+    return static_cast<uint32_t>(nodes.size() - 1);
+}
+
+uint32_t Trie::newSongEntry(uint32_t songId) {
+    if (freeSongEntries != TrieNode::noSong) {
+        uint32_t entry = freeSongEntries;
+        freeSongEntries = songEntries[entry].next;
+        songEntries[entry] = {songId, TrieNode::noSong};
+        return entry;
+    }
+    songEntries.push_back({songId, TrieNode::noSong});
+    return static_cast<uint32_t>(songEntries.size() - 1);
+}
+
+// key is already normalized by titleKey, returns the node the song went to
+uint32_t Trie::insertKey(std::string_view key, uint32_t songId) {
+    uint32_t node = 0;
+    for (char c : key) {
+        auto label = static_cast<uint8_t>(c);
+        // find the child or the spot where it goes in the sorted list
+        uint32_t previous = 0;
+        uint32_t child = nodes[node].firstChild;
+        while (child && nodes[child].label < label) {
+            previous = child;
+            child = nodes[child].nextSibling;
+        }
+        if (!child || nodes[child].label != label) {
+            // newNode can move the arena, so index it again afterwards
+            uint32_t added = newNode();
+            nodes[added].label = label;
+            nodes[added].nextSibling = child;
+            parents[added] = node;
+            if (previous)
+                nodes[previous].nextSibling = added;
+            else
+                nodes[node].firstChild = added;
+            child = added;
+        }
+        node = child;
+    }
+
+    // the top lists would be stale now
+    topRanges.clear();
+    topEntries.clear();
+
+    uint32_t entry = newSongEntry(songId);
+    if (nodes[node].isEndOfWord())
+        songEntries[nodes[node].lastSong].next = entry;
+    else
+        nodes[node].firstSong = entry;
+    nodes[node].lastSong = entry;
+    return node;
+}
+
+void Trie::build(const std::vector<Songs> &songs, unsigned threadCount) {
+    if (threadCount == 0)
+        threadCount = defaultThreadCount();
+    auto songCount = static_cast<uint32_t>(songs.size());
+
+    // the keys, each thread taking an even slice of the songs
+    std::vector<std::string> keys(songCount);
+    runOnThreads(threadCount, [&](unsigned thread) {
+        size_t begin = size_t(songCount) * thread / threadCount;
+        size_t end = size_t(songCount) * (thread + 1) / threadCount;
+        for (size_t id = begin; id < end; ++id)
+            keys[id] = titleKey(songs[id].name);
+    });
+
+    // one part per first byte, empty keys end at the root itself
+    std::vector<std::vector<uint32_t>> partIds(256);
+    std::vector<uint32_t> rootIds;
+    for (uint32_t id = 0; id < songCount; ++id) {
+        if (keys[id].empty())
+            rootIds.push_back(id);
+        else
+            partIds[static_cast<uint8_t>(keys[id][0])].push_back(id);
+    }
+
+    // every part is a trie of its own whose root stands for the first byte.
+    // a few letters hold most titles, so threads take the biggest parts first
+    // instead of a fixed share of the alphabet.
+    std::vector<uint8_t> order;
+    for (unsigned label = 0; label < 256; ++label) {
+        if (!partIds[label].empty())
+            order.push_back(static_cast<uint8_t>(label));
+    }
+    std::stable_sort(order.begin(), order.end(), [&](uint8_t a, uint8_t b) {
+        return partIds[a].size() > partIds[b].size();
+    });
+    std::vector<Trie> parts(256);
+    std::atomic<size_t> nextPart {0};
+    runOnThreads(std::min<unsigned>(threadCount, std::max<size_t>(order.size(), 1)), [&](unsigned) {
+        for (size_t i; (i = nextPart.fetch_add(1)) < order.size();) {
+            uint8_t label = order[i];
+            for (uint32_t id : partIds[label])
+                parts[label].insertKey(std::string_view(keys[id]).substr(1), id);
+        }
+    });
+    keys = {};
+
+    // songs went in by id, so inserting them one by one would have put song
+    // id at entry id. doing the same here keeps the entries (and with them the
+    // tie breaks in buildTopK) exactly as a sequential build leaves them.
+    nodes.assign(1, TrieNode());
+    songEntries.assign(songCount, {0, TrieNode::noSong});
+    topRanges.clear();
+    topEntries.clear();
+    auto songList = [&](const std::vector<uint32_t> &ids, TrieNode &node) {
+        for (uint32_t id : ids) {
+            songEntries[id].songId = id;
+            if (node.isEndOfWord())
+                songEntries[node.lastSong].next = id;
+            else
+                node.firstSong = id;
+            node.lastSong = id;
+        }
+    };
+    songList(rootIds, nodes[0]);
+
+    // the parts go under the root in label order, each one's indexes shifted
+    // past the nodes already there, which keeps children after their parent
+    uint32_t previousPart = 0;
+    for (unsigned label = 0; label < 256; ++label) {
+        const Trie &part = parts[label];
+        if (partIds[label].empty())
+            continue;
+        auto base = static_cast<uint32_t>(nodes.size());
+        for (const TrieNode &node : part.nodes) {
+            TrieNode moved = node;
+            moved.firstChild = node.firstChild ? node.firstChild + base : 0;
+            moved.nextSibling = node.nextSibling ? node.nextSibling + base : 0;
+            if (node.isEndOfWord()) {
+                moved.firstSong = part.songEntries[node.firstSong].songId;
+                moved.lastSong = part.songEntries[node.lastSong].songId;
+            }
+            nodes.push_back(moved);
+        }
+        for (const SongEntry &entry : part.songEntries) {
+            songEntries[entry.songId] = {entry.songId, entry.next == TrieNode::noSong
+                                                           ? TrieNode::noSong
+                                                           : part.songEntries[entry.next].songId};
+        }
+        nodes[base].label = static_cast<uint8_t>(label);
+        if (previousPart)
+            nodes[previousPart].nextSibling = base;
+        else
+            nodes[0].firstChild = base;
+        previousPart = base;
+    }
+    relink(songCount);
+}
+
+// works out parents and songNodes from the arenas, and puts every node and
+// song entry nothing links to on the free lists. false if some node or song
+// is linked twice, which only a damaged snapshot can do.
+bool Trie::relink(uint32_t songCount) {
+    parents.assign(nodes.size(), TrieNode::noSong);
+    songNodes.assign(songCount, TrieNode::noSong);
+    std::vector<bool> entryUsed(songEntries.size());
+    std::vector<uint32_t> stack {0};
+    while (!stack.empty()) {
+        uint32_t node = stack.back();
+        stack.pop_back();
+        for (uint32_t entry = nodes[node].firstSong; entry != TrieNode::noSong; entry = songEntries[entry].next) {
+            uint32_t songId = songEntries[entry].songId;
+            if (entryUsed[entry] || songId >= songCount || songNodes[songId] != TrieNode::noSong)
+                return false;
+            entryUsed[entry] = true;
+            songNodes[songId] = node;
+        }
+        for (uint32_t child = nodes[node].firstChild; child; child = nodes[child].nextSibling) {
+            if (parents[child] != TrieNode::noSong)
+                return false;
+            parents[child] = node;
+            stack.push_back(child);
+        }
+    }
+
+    // backwards so the lowest slots get handed out first
+    freeNodes = 0;
+    freeNodeCount = 0;
+    for (size_t node = nodes.size(); node-- > 1;) {
+        if (parents[node] == TrieNode::noSong) {
+            nodes[node] = TrieNode();
+            nodes[node].nextSibling = freeNodes;
+            freeNodes = static_cast<uint32_t>(node);
+            ++freeNodeCount;
+        }
+    }
+    freeSongEntries = TrieNode::noSong;
+    for (size_t entry = songEntries.size(); entry-- > 0;) {
+        if (!entryUsed[entry]) {
+            songEntries[entry] = {0, freeSongEntries};
+            freeSongEntries = static_cast<uint32_t>(entry);
+        }
+    }
+    return true;
+}
+
+uint64_t Trie::byInsertion(uint32_t, uint32_t insertOrder) {
+    return insertOrder;
+}
+
+Trie::RankKey Trie::byTitleLength(const std::vector<Songs> &songs) {
+    return [&songs](uint32_t songId, uint32_t) {
+        return static_cast<uint64_t>(songs[songId].name.size());
+    };
+}
+
+// child of node along label, or 0 if there is none
+uint32_t Trie::findChild(uint32_t node, uint8_t label) const {
+    for (uint32_t child = nodes[node].firstChild; child; child = nodes[child].nextSibling) {
+        if (nodes[child].label >= label)
+            return nodes[child].label == label ? child : 0;
+    }
+    return 0;
+}
+
+// node the query leads to, or noSong if no title starts with it
+uint32_t Trie::findNode(std::string_view query) const {
+    uint32_t node = 0;
+    for (char c : titleKey(query)) {
+        node = findChild(node, static_cast<uint8_t>(c));
+        if (!node)
+            return TrieNode::noSong;
+    }
+    return node;
+}
+
+void Trie::search(std::string_view query, std::vector<uint32_t> &results, size_t limit, size_t offset) const {
+    uint32_t node = findNode(query);
+    if (node != TrieNode::noSong)
+        collectSongs(node, results, limit, offset);
+}
+
+size_t Trie::count(std::string_view query) const {
+    uint32_t node = findNode(query);
+    if (node == TrieNode::noSong)
+        return 0;
+    size_t songs = 0;
+    std::vector<uint32_t> stack {node};
+    while (!stack.empty()) {
+        uint32_t index = stack.back();
+        const TrieNode &current = nodes[index];
+        stack.pop_back();
+        for (uint32_t entry = current.firstSong; entry != TrieNode::noSong; entry = songEntries[entry].next)
+            ++songs;
+        if (index != node && current.nextSibling)
+            stack.push_back(current.nextSibling);
+        if (current.firstChild)
+            stack.push_back(current.firstChild);
+    }
+    return songs;
+}
+
+void Trie::buildTopK(size_t k, const RankKey &rank) {
+    // the nodes in the order a full search visits them
+    std::vector<uint32_t> preorder;
+    preorder.reserve(nodeCount());
+    std::vector<uint32_t> stack {0};
+    while (!stack.empty()) {
+        uint32_t node = stack.back();
+        stack.pop_back();
+        preorder.push_back(node);
+        if (nodes[node].nextSibling)
+            stack.push_back(nodes[node].nextSibling);
+        if (nodes[node].firstChild)
+            stack.push_back(nodes[node].firstChild);
+    }
+
+    std::vector<uint64_t> rankOf(songEntries.size());
+    if (rank) {
+        for (uint32_t entry = 0; entry < songEntries.size(); ++entry)
+            rankOf[entry] = rank(songEntries[entry].songId, entry);
+    } else {
+        // number the songs in that order
+        uint64_t next = 0;
+        for (uint32_t node : preorder) {
+            for (uint32_t entry = nodes[node].firstSong; entry != TrieNode::noSong; entry = songEntries[entry].next)
+                rankOf[entry] = next++;
+        }
+    }
+    // ties go to the song inserted first
+    auto better = [&](uint32_t a, uint32_t b) {
+        return rankOf[a] != rankOf[b] ? rankOf[a] < rankOf[b] : a < b;
+    };
+
+    topK = k;
+    topRanges.assign(nodes.size(), {0, 0});
+    topEntries.clear();
+    topEntries.reserve(nodes.size() * std::min<size_t>(k, 2));
+
+    // children come after their parent in preorder, so going backwards every
+    // child's list is ready before its parent needs it. (arena order would
+    // not do, erase hands old slots to new nodes.)
+    std::vector<uint32_t> candidates;
+    for (size_t i = preorder.size(); i-- > 0;) {
+        uint32_t node = preorder[i];
+        candidates.clear();
+        for (uint32_t entry = nodes[node].firstSong; entry != TrieNode::noSong; entry = songEntries[entry].next)
+            candidates.push_back(entry);
+        for (uint32_t child = nodes[node].firstChild; child; child = nodes[child].nextSibling) {
+            const TopRange &range = topRanges[child];
+            candidates.insert(candidates.end(), topEntries.begin() + range.start,
+                              topEntries.begin() + range.start + range.count);
+        }
+        size_t keep = std::min(k, candidates.size());
+        std::partial_sort(candidates.begin(), candidates.begin() + keep, candidates.end(), better);
+        topRanges[node] = {static_cast<uint32_t>(topEntries.size()), static_cast<uint32_t>(keep)};
+        topEntries.insert(topEntries.end(), candidates.begin(), candidates.begin() + keep);
+    }
+}
+
+void Trie::top(std::string_view query, std::vector<uint32_t> &results) const {
+    if (topRanges.empty()) {
+        search(query, results, topK ? topK : SIZE_MAX);
+        return;
+    }
+    uint32_t node = findNode(query);
+    if (node == TrieNode::noSong)
+        return;
+    const TopRange &range = topRanges[node];
+    for (uint32_t i = range.start; i < range.start + range.count; ++i)
+        results.push_back(songEntries[topEntries[i]].songId);
+}
+
+// walks the trie with the Levenshtein automaton for the query: every node
+// gets the DP row of edit distances from the query's prefixes to the node's
+// key, made from its parent's row. a row whose smallest entry is over
+// maxEdits is dead, nothing below it can get back in range, so the subtree
+// is skipped unless one of its prefixes already matched.
+void Trie::fuzzySearch(std::string_view query, size_t maxEdits, std::vector<uint32_t> &results,
+                       size_t limit) const {
+    std::string key = titleKey(query);
+    // the empty prefix is key.size() edits away, so every title is within
+    // that many and a bigger maxEdits changes nothing (SIZE_MAX + 1 would wrap)
+    maxEdits = std::min(maxEdits, key.size());
+    size_t width = key.size() + 1;
+    // rows by depth: a node's parent row is always the last one written one
+    // level up, everything popped in between is deeper
+    std::vector<uint32_t> rows(width);
+    for (size_t i = 0; i < width; ++i)
+        rows[i] = static_cast<uint32_t>(i);
+
+    // matches by distance, none of them needs more than limit songs
+    std::vector<std::vector<uint32_t>> found(maxEdits + 1);
+    auto filled = [&](size_t distance) {
+        size_t count = 0;
+        for (size_t d = 0; d <= distance; ++d)
+            count += found[d].size();
+        return count >= limit;
+    };
+
+    // best is the closest any prefix on the way here came to the whole
+    // query, live is false once the row died and only best still counts
+    struct Step {
+        uint32_t node;
+        uint32_t depth;
+        size_t best;
+        bool live;
+    };
+    std::vector<Step> stack {{0, 0, key.size(), true}};
+    while (!stack.empty() && limit) {
+        Step step = stack.back();
+        stack.pop_back();
+        const TrieNode &node = nodes[step.node];
+        if (step.node && node.nextSibling)
+            stack.push_back({node.nextSibling, step.depth, step.best, step.live});
+
+        size_t best = step.best;
+        size_t reachable = best; // the least distance anything below can still get
+        if (step.live && step.node) {
+            if (rows.size() < (step.depth + 1) * width)
+                rows.resize((step.depth + 1) * width);
+            const uint32_t *above = rows.data() + (step.depth - 1) * width;
+            uint32_t *row = rows.data() + step.depth * width;
+            row[0] = above[0] + 1;
+            uint32_t smallest = row[0];
+            for (size_t i = 1; i < width; ++i) {
+                uint32_t substitute = above[i - 1] + (static_cast<uint8_t>(key[i - 1]) != node.label);
+                row[i] = std::min({above[i] + 1, row[i - 1] + 1, substitute});
+                smallest = std::min(smallest, row[i]);
+            }
+            best = std::min<size_t>(best, row[width - 1]);
+            reachable = std::min<size_t>(best, smallest);
+        } else if (step.live) {
+            reachable = 0;
+        }
+        bool live = step.live && reachable < best;
+
+        if (best <= maxEdits && !filled(best)) {
+            for (uint32_t entry = node.firstSong; entry != TrieNode::noSong && found[best].size() < limit;
+                 entry = songEntries[entry].next)
+                found[best].push_back(songEntries[entry].songId);
+        }
+        // skip the subtree once nothing in it could make the cut
+        if (node.firstChild && reachable <= maxEdits && !filled(reachable))
+            stack.push_back({node.firstChild, step.depth + 1, best, live});
+    }
+
+    size_t added = 0;
+    for (const auto &songs : found) {
+        for (uint32_t songId : songs) {
+            if (added++ == limit)
+                return;
+            results.push_back(songId);
+        }
+    }
+}
+
+// preorder with an explicit stack so a long title chain can't overflow the
+// call stack, and it stops as soon as limit songs are in. after a node come
+// its children, then its next sibling, so pushing (sibling, first child)
+// keeps the sorted order.
+void Trie::collectSongs(uint32_t node, std::vector<uint32_t> &results, size_t limit, size_t offset) const {
+    if (limit == 0)
+        return;
+    size_t added = 0;
+    std::vector<uint32_t> stack {node};
+    while (!stack.empty()) {
+        uint32_t index = stack.back();
+        const TrieNode &current = nodes[index];
+        stack.pop_back();
+        for (uint32_t entry = current.firstSong; entry != TrieNode::noSong; entry = songEntries[entry].next) {
+            if (offset) {
+                --offset;
+                continue;
+            }
+            results.push_back(songEntries[entry].songId);
+            if (++added == limit)
+                return;
+        }
+        // the starting node's siblings are not under the prefix
+        if (index != node && current.nextSibling)
+            stack.push_back(current.nextSibling);
+        if (current.firstChild)
+            stack.push_back(current.firstChild);
+    }
+}
+
+size_t Trie::memoryUsage() const {
+    return nodes.capacity() * sizeof(TrieNode) + songEntries.capacity() * sizeof(SongEntry)
+         + (parents.capacity() + songNodes.capacity() + topEntries.capacity()) * sizeof(uint32_t)
+         + topRanges.capacity() * sizeof(TopRange);
+}
+
+// [node count, song count, nodes as raw words..., songs as raw words...]
+void Trie::save(std::vector<uint32_t> &out) const {
+    out.push_back(static_cast<uint32_t>(nodes.size()));
+    out.push_back(static_cast<uint32_t>(songEntries.size()));
+
+    size_t start = out.size();
+    out.resize(start + nodes.size() * nodeWords + songEntries.size() * songWords);
+    std::memcpy(out.data() + start, nodes.data(), nodes.size() * sizeof(TrieNode));
+    if (!songEntries.empty()) // an empty vector's data() can be null, which memcpy may not get
+        std::memcpy(out.data() + start + nodes.size() * nodeWords, songEntries.data(),
+                    songEntries.size() * sizeof(SongEntry));
+}
+
+bool Trie::load(const uint32_t *words, size_t count, uint32_t songCount) {
+    if (count < 2)
+        return false;
+    size_t nodeCount = words[0];
+    size_t entryCount = words[1];
+    if (nodeCount == 0 || count != 2 + nodeCount * nodeWords + entryCount * songWords)
+        return false;
+    words += 2;
+
+    // two bulk copies, no per node work beyond checking the indexes
+    std::vector<TrieNode> loadedNodes(nodeCount);
+    std::memcpy(static_cast<void *>(loadedNodes.data()), words, nodeCount * sizeof(TrieNode));
+    std::vector<SongEntry> loadedSongs(entryCount);
+    if (entryCount)
+        std::memcpy(loadedSongs.data(), words + nodeCount * nodeWords, entryCount * sizeof(SongEntry));
+
+    for (const auto &node : loadedNodes) {
+        if (node.firstChild >= nodeCount || node.nextSibling >= nodeCount)
+            return false;
+        if ((node.firstSong != TrieNode::noSong && node.firstSong >= entryCount)
+            || (node.lastSong != TrieNode::noSong && node.lastSong >= entryCount))
+            return false;
+    }
+    for (const auto &entry : loadedSongs) {
+        if (entry.songId >= songCount || (entry.next != TrieNode::noSong && entry.next >= entryCount))
+            return false;
+    }
+
+    Trie loaded;
+    loaded.nodes = std::move(loadedNodes);
+    loaded.songEntries = std::move(loadedSongs);
+    if (!loaded.relink(songCount))
+        return false;
+    *this = std::move(loaded);
+    return true;
+}
@@ -0,0 +1,119 @@
+//
+// Prefix tree over song titles, used by the search box
+//
+
+#ifndef TRIE_H
+#define TRIE_H
+#include <cstdint>
+#include <functional>
+#include <string_view>
+#include <vector>
+#include "Songs.h"
+
+//makes node for trie, one per byte of the (UTF-8) title key. children are a
+//list sorted by label, linked through indexes into the trie's node arena,
+//and 0 means none (0 is the root, which is never anyone's child or sibling).
+//a freed node keeps its slot, nextSibling then links the free list.
+struct TrieNode {
+    static constexpr uint32_t noSong = UINT32_MAX;
+
+    uint32_t firstChild = 0;
+    uint32_t nextSibling = 0;
+    uint32_t firstSong = noSong; // this node's songs, a list in the song arena
+    uint32_t lastSong = noSong;
+    uint8_t label = 0;           // key byte on the edge from the parent
+
+    bool isEndOfWord() const { return firstSong != noSong; }
+};
+
+//beginning of trie class
+class Trie {
+public:
+    // ranks songs for the top lists, lower comes first. insertOrder counts
+    // up from 0 in the order songs went into the trie, though after an erase
+    // the freed slot goes to the next song inserted.
+    using RankKey = std::function<uint64_t(uint32_t songId, uint32_t insertOrder)>;
+    static uint64_t byInsertion(uint32_t songId, uint32_t insertOrder);
+    static RankKey byTitleLength(const std::vector<Songs> &songs);
+
+    Trie();
+
+    // songId is the song's index in the song table, the trie only keeps that.
+    // a song is only in the trie once, inserting it again retitles it like
+    // update() does.
+    void insert(std::string_view songName, uint32_t songId);
+    // takes the song out and frees the nodes only it was using, false if it
+    // is not in the trie
+    bool erase(uint32_t songId);
+    // files the song under a new title, false if it is not in the trie
+    bool update(uint32_t songId, std::string_view newName);
+    // replaces the contents with every song, same trie as inserting them in id
+    // order. titles are split by their first key byte and each part is built
+    // on its own thread, 0 threads means one per core.
+    void build(const std::vector<Songs> &songs, unsigned threadCount = 0);
+    // appends the ids of songs whose title starts with query, skipping the
+    // first offset matches and stopping after limit of them
+    void search(std::string_view query, std::vector<uint32_t> &results,
+                size_t limit = SIZE_MAX, size_t offset = 0) const;
+    // how many songs search() would return with no limit
+    size_t count(std::string_view query) const;
+
+    // like search, but a title also matches when some prefix of it is within
+    // maxEdits insertions, deletions or substitutions (of key bytes) of the
+    // query. closest matches come first, then search order.
+    void fuzzySearch(std::string_view query, size_t maxEdits, std::vector<uint32_t> &results,
+                     size_t limit = SIZE_MAX) const;
+
+    // stores the best k songs under every node, bottom up, so top() only has to
+    // walk the prefix. no rank means the order search() returns songs in.
+    // inserting afterwards drops the lists until this is called again.
+    void buildTopK(size_t k, const RankKey &rank = {});
+    // the best (up to) k songs for query, falls back to a full search when
+    // the top lists have not been built
+    void top(std::string_view query, std::vector<uint32_t> &results) const;
+
+    // nodes in use, freed ones are not counted
+    size_t nodeCount() const { return nodes.size() - freeNodeCount; }
+    size_t memoryUsage() const;
+
+    // flat dump for the snapshot file, the node and song arenas as they are
+    // (free slots included, load() finds them again)
+    void save(std::vector<uint32_t> &out) const;
+    // rebuilds the trie from save() output, false if the words are malformed
+    // or name a song id of songCount or more
+    bool load(const uint32_t *words, size_t count, uint32_t songCount);
+
+private:
+    struct SongEntry {
+        uint32_t songId;
+        uint32_t next; // next song ending at the same node
+    };
+
+    // where a node's best songs sit in topEntries
+    struct TopRange {
+        uint32_t start;
+        uint32_t count;
+    };
+
+    uint32_t insertKey(std::string_view key, uint32_t songId);
+    uint32_t newNode();
+    uint32_t newSongEntry(uint32_t songId);
+    bool relink(uint32_t songCount);
+    uint32_t findChild(uint32_t node, uint8_t label) const;
+    uint32_t findNode(std::string_view query) const;
+    void collectSongs(uint32_t node, std::vector<uint32_t> &results, size_t limit, size_t offset) const;
+
+    std::vector<TrieNode> nodes;
+    std::vector<SongEntry> songEntries;
+    // not saved, relink() works them out from the arenas
+    std::vector<uint32_t> parents;   // per node, noSong for the root and free nodes
+    std::vector<uint32_t> songNodes; // per song id, the node its title ends at or noSong
+    uint32_t freeNodes = 0;          // free node list, 0 is the end
+    uint32_t freeSongEntries = TrieNode::noSong;
+    size_t freeNodeCount = 0;
+    size_t topK = 0;
+    std::vector<TopRange> topRanges; // one per node once buildTopK ran
+    std::vector<uint32_t> topEntries;
+};
+
+#endif //TRIE_H
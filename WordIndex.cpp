@@ -0,0 +1,525 @@
+//
+// Inverted index over the words of one song field, the lyrics unless told
+// otherwise: for every word, the songs that use it and how often. Postings
+// are kept in blocks of 128 songs, ids as differences and counts as they
+// are, both StreamVByte coded, with each block's last id kept aside so a
+// cursor can skip blocks without decoding them. Ranked
+// queries score by BM25 and use each block's best score to skip the blocks
+// that cannot make the top k (Block-Max WAND). Where in the song each word
+// is goes in a stream of its own, only phrase queries decode it.
+//
+
+#include "WordIndex.h"
+#include "BranchlessSearch.h"
+#include "Parallel.h"
+#include "StreamVByte.h"
+#include "TitleKey.h"
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+namespace {
+
+// raw postings for one slice of the songs
+struct Partial {
+    std::unordered_map<std::string, uint32_t> termOf;
+    std::vector<std::vector<uint32_t>> songLists;
+    std::vector<std::vector<uint32_t>> frequencyLists;
+    // each posting's positions one after the other, its frequency says how many
+    std::vector<std::vector<uint32_t>> positionLists;
+};
+
+// the first in [first, last) that fails pred, trying 1, 2, 4... ahead
+// before the binary search, so a target close by is found in a few steps
+template <typename Iterator, typename Pred>
+Iterator gallop(Iterator first, Iterator last, Pred pred) {
+    size_t size = last - first;
+    size_t bound = 1;
+    while (bound < size && pred(first[bound]))
+        bound *= 2;
+    return std::partition_point(first + bound / 2, first + std::min(bound + 1, size), pred);
+}
+
+// one word's share of a song's score. the bounds are made with this too, so
+// a sum of them is never below the sum of the scores they stand for.
+float bm25(float weight, uint32_t frequency, float lengthNorm) {
+    return weight * static_cast<float>(frequency) / (static_cast<float>(frequency) + lengthNorm);
+}
+
+// songs come in id order, so a word this song already used has it as its
+// last posting. lengths gets every song's word count.
+void collectWords(const std::vector<Songs> &songs, std::string_view Songs::*field, size_t begin, size_t end,
+                  Partial &part, std::vector<uint32_t> &lengths) {
+    std::string word;
+    for (size_t id = begin; id < end; ++id) {
+        size_t pos = 0;
+        while (nextWord(songs[id].*field, pos, word)) {
+            uint32_t position = lengths[id]++;
+            auto [it, added] = part.termOf.try_emplace(word, static_cast<uint32_t>(part.songLists.size()));
+            if (added) {
+                part.songLists.emplace_back();
+                part.frequencyLists.emplace_back();
+                part.positionLists.emplace_back();
+            }
+            part.positionLists[it->second].push_back(position);
+            std::vector<uint32_t> &list = part.songLists[it->second];
+            if (!list.empty() && list.back() == id) {
+                ++part.frequencyLists[it->second].back();
+            } else {
+                list.push_back(static_cast<uint32_t>(id));
+                part.frequencyLists[it->second].push_back(1);
+            }
+        }
+    }
+}
+
+}
+
+void WordIndex::build(const std::vector<Songs> &songs, std::string_view Songs::*field, unsigned threadCount) {
+    if (threadCount == 0)
+        threadCount = defaultThreadCount();
+    threadCount = static_cast<unsigned>(std::clamp<size_t>(songs.size() / 1024, 1, threadCount));
+
+    // every thread takes an even slice of the songs
+    std::vector<Partial> parts(threadCount);
+    std::vector<uint32_t> lengths(songs.size(), 0);
+    runOnThreads(threadCount, [&](unsigned thread) {
+        collectWords(songs, field, songs.size() * thread / threadCount, songs.size() * (thread + 1) / threadCount,
+                     parts[thread], lengths);
+    });
+
+    uint64_t totalLength = 0;
+    for (uint32_t length : lengths)
+        totalLength += length;
+    float averageLength = std::max(1.0f, static_cast<float>(totalLength) / std::max<size_t>(songs.size(), 1));
+    lengthNorms.resize(songs.size());
+    for (size_t id = 0; id < songs.size(); ++id)
+        lengthNorms[id] = k1 * (1 - b + b * static_cast<float>(lengths[id]) / averageLength);
+
+    // each word's list in every slice, the slices are in id order so their
+    // lists just go one after the other
+    constexpr uint32_t missing = UINT32_MAX;
+    std::unordered_map<std::string_view, std::vector<uint32_t>> slicesOf;
+    for (unsigned thread = 0; thread < threadCount; ++thread) {
+        for (const auto &[word, term] : parts[thread].termOf) {
+            auto &slices = slicesOf.try_emplace(word, threadCount, missing).first->second;
+            slices[thread] = term;
+        }
+    }
+    std::vector<const std::pair<const std::string_view, std::vector<uint32_t>> *> sorted;
+    sorted.reserve(slicesOf.size());
+    for (const auto &entry : slicesOf)
+        sorted.push_back(&entry);
+    std::sort(sorted.begin(), sorted.end(), [](auto a, auto b) { return a->first < b->first; });
+
+    words.clear();
+    wordOffsets.assign(1, 0);
+    terms.clear();
+    blocks.clear();
+    songData.clear();
+    frequencyData.clear();
+    positionData.clear();
+    postings = 0;
+    std::vector<uint32_t> list;
+    std::vector<uint32_t> frequencies;
+    std::vector<uint32_t> positions;
+    for (auto entry : sorted) {
+        words += entry->first;
+        wordOffsets.push_back(static_cast<uint32_t>(words.size()));
+
+        list.clear();
+        frequencies.clear();
+        positions.clear();
+        for (unsigned thread = 0; thread < threadCount; ++thread) {
+            uint32_t term = entry->second[thread];
+            if (term == missing)
+                continue;
+            auto &songList = parts[thread].songLists[term];
+            auto &frequencyList = parts[thread].frequencyLists[term];
+            auto &positionList = parts[thread].positionLists[term];
+            list.insert(list.end(), songList.begin(), songList.end());
+            frequencies.insert(frequencies.end(), frequencyList.begin(), frequencyList.end());
+            positions.insert(positions.end(), positionList.begin(), positionList.end());
+            // done with it, keeps the peak down
+            songList = {};
+            frequencyList = {};
+            positionList = {};
+        }
+
+        // the idf that can't go negative for words in most songs
+        double songCount = static_cast<double>(songs.size());
+        double listSize = static_cast<double>(list.size());
+        auto weight = static_cast<float>(std::log(1 + (songCount - listSize + 0.5) / (listSize + 0.5)) * (k1 + 1));
+        terms.push_back({static_cast<uint32_t>(blocks.size()), 0, static_cast<uint32_t>(list.size()), weight, 0});
+        uint32_t previous = 0;
+        const uint32_t *position = positions.data();
+        for (size_t start = 0; start < list.size(); start += blockSize) {
+            size_t count = std::min(blockSize, list.size() - start);
+            Block block {list[start + count - 1], static_cast<uint32_t>(songData.size()),
+                         static_cast<uint32_t>(frequencyData.size()), static_cast<uint32_t>(positionData.size()),
+                         static_cast<uint32_t>(count), 0};
+            for (size_t i = start; i < start + count; ++i) {
+                block.maxScore = std::max(block.maxScore, bm25(weight, frequencies[i], lengthNorms[list[i]]));
+                streamVByteEncodeDelta(position, frequencies[i], 0, positionData);
+                position += frequencies[i];
+            }
+            terms.back().maxScore = std::max(terms.back().maxScore, block.maxScore);
+            streamVByteEncodeDelta(list.data() + start, count, previous, songData);
+            streamVByteEncode(frequencies.data() + start, count, frequencyData);
+            blocks.push_back(block);
+            previous = block.lastSong;
+        }
+        terms.back().blockCount = static_cast<uint32_t>(blocks.size()) - terms.back().firstBlock;
+        postings += list.size();
+    }
+    words.shrink_to_fit();
+    songData.shrink_to_fit();
+    frequencyData.shrink_to_fit();
+    positionData.shrink_to_fit();
+}
+
+size_t WordIndex::findTerm(std::string_view word) const {
+    size_t term = branchlessLowerBound(terms.size(), [&](size_t i) { return wordAt(i) < word; });
+    return term < terms.size() && wordAt(term) == word ? term : terms.size();
+}
+
+WordIndex::Cursor WordIndex::cursor(std::string_view word) const {
+    return cursorAt(findTerm(word));
+}
+
+WordIndex::Cursor WordIndex::cursorAt(size_t term) const {
+    Cursor cursor;
+    cursor.index = this;
+    if (term == terms.size())
+        return cursor;
+    cursor.firstBlock = terms[term].firstBlock;
+    cursor.endBlock = terms[term].firstBlock + terms[term].blockCount;
+    cursor.listSongs = terms[term].songCount;
+    cursor.weight = terms[term].weight;
+    cursor.listMaxScore = terms[term].maxScore;
+    cursor.load(cursor.firstBlock);
+    return cursor;
+}
+
+size_t WordIndex::prefixCursors(std::string_view prefix, std::vector<Cursor> &out, size_t limit) const {
+    size_t first = branchlessLowerBound(terms.size(), [&](size_t i) { return wordAt(i) < prefix; });
+    std::string successor;
+    size_t last = keySuccessor(prefix, successor)
+                ? branchlessLowerBound(terms.size(), [&](size_t i) { return wordAt(i) < successor; })
+                : terms.size();
+
+    std::vector<uint32_t> matching;
+    for (size_t term = first; term < last; ++term)
+        matching.push_back(static_cast<uint32_t>(term));
+    size_t total = matching.size();
+    if (matching.size() > limit) {
+        std::nth_element(matching.begin(), matching.begin() + static_cast<ptrdiff_t>(limit), matching.end(),
+                         [this](uint32_t a, uint32_t b) { return terms[a].songCount > terms[b].songCount; });
+        matching.resize(limit);
+    }
+    for (uint32_t term : matching)
+        out.push_back(cursorAt(term));
+    return total;
+}
+
+void WordIndex::Cursor::load(uint32_t block) {
+    this->block = block;
+    position = 0;
+    frequenciesLoaded = false;
+    positionPosting = 0;
+    if (block == endBlock)
+        return;
+    const Block &coded = index->blocks[block];
+    positionByte = coded.positionOffset;
+    uint32_t previous = block > firstBlock ? index->blocks[block - 1].lastSong : 0;
+    count = coded.count;
+    const std::vector<uint8_t> &data = index->songData;
+    streamVByteDecodeDelta(data.data() + coded.songOffset, data.data() + data.size(), count, previous, songs);
+}
+
+uint32_t WordIndex::Cursor::frequency() const {
+    if (!frequenciesLoaded) {
+        const Block &coded = index->blocks[block];
+        const std::vector<uint8_t> &data = index->frequencyData;
+        streamVByteDecode(data.data() + coded.frequencyOffset, data.data() + data.size(), count, frequencies);
+        frequenciesLoaded = true;
+    }
+    return frequencies[position];
+}
+
+void WordIndex::Cursor::positions(std::vector<uint32_t> &out) const {
+    frequency(); // the counts say how long each posting's positions are
+    const std::vector<uint8_t> &data = index->positionData;
+    if (positionPosting > position) {
+        positionPosting = 0;
+        positionByte = index->blocks[block].positionOffset;
+    }
+    for (; positionPosting < position; ++positionPosting)
+        positionByte += static_cast<uint32_t>(streamVByteSkip(data.data() + positionByte, frequencies[positionPosting]));
+    out.resize(frequencies[position]);
+    streamVByteDecodeDelta(data.data() + positionByte, data.data() + data.size(), out.size(), 0, out.data());
+}
+
+float WordIndex::Cursor::score() const {
+    return bm25(weight, frequency(), index->lengthNorms[song()]);
+}
+
+void WordIndex::Cursor::next() {
+    if (++position == count)
+        load(block + 1);
+}
+
+void WordIndex::Cursor::advance(uint32_t song) {
+    if (atEnd() || songs[position] >= song)
+        return;
+    if (index->blocks[block].lastSong < song) {
+        load(blockFor(song));
+        if (atEnd())
+            return;
+    }
+    position = static_cast<uint32_t>(gallop(songs + position, songs + count, [song](uint32_t s) { return s < song; }) - songs);
+}
+
+uint32_t WordIndex::Cursor::blockFor(uint32_t song) const {
+    if (atEnd() || index->blocks[block].lastSong >= song)
+        return block;
+    // the first later block that reaches song
+    const Block *blocksData = index->blocks.data();
+    const Block *found = gallop(blocksData + block + 1, blocksData + endBlock,
+                               [song](const Block &b) { return b.lastSong < song; });
+    return static_cast<uint32_t>(found - blocksData);
+}
+
+void WordIndex::search(std::string_view query, std::vector<uint32_t> &results, size_t limit, size_t offset) const {
+    std::vector<Cursor> cursors;
+    std::string word;
+    size_t pos = 0;
+    while (nextWord(query, pos, word)) {
+        cursors.push_back(cursor(word));
+        if (cursors.back().atEnd())
+            return; // no song has this word, so none has them all
+    }
+    if (cursors.empty() || limit == 0)
+        return;
+    // rarest word first, it proposes the candidates and the rest jump to them
+    std::sort(cursors.begin(), cursors.end(),
+              [](const Cursor &a, const Cursor &b) { return a.songCount() < b.songCount(); });
+
+    size_t added = 0;
+    while (alignCursors(cursors)) {
+        if (offset) {
+            --offset;
+        } else {
+            results.push_back(cursors[0].song());
+            if (++added == limit)
+                return;
+        }
+        cursors[0].next();
+    }
+}
+
+bool WordIndex::alignCursors(std::vector<Cursor> &cursors) {
+    Cursor &lead = cursors[0];
+    while (!lead.atEnd()) {
+        uint32_t candidate = lead.song();
+        bool everywhere = true;
+        for (size_t i = 1; i < cursors.size(); ++i) {
+            cursors[i].advance(candidate);
+            if (cursors[i].atEnd())
+                return false;
+            if (cursors[i].song() != candidate) {
+                lead.advance(cursors[i].song());
+                everywhere = false;
+                break;
+            }
+        }
+        if (everywhere)
+            return true;
+    }
+    return false;
+}
+
+void WordIndex::phraseSearch(std::string_view phrase, std::vector<uint32_t> &results, size_t limit,
+                               size_t slop) const {
+    // one cursor per distinct word, and for every word of the phrase which
+    // cursor is its
+    std::vector<std::string> distinct;
+    std::vector<size_t> phraseWords;
+    std::string word;
+    size_t pos = 0;
+    while (nextWord(phrase, pos, word)) {
+        auto found = std::find(distinct.begin(), distinct.end(), word);
+        phraseWords.push_back(found - distinct.begin());
+        if (found == distinct.end())
+            distinct.push_back(word);
+    }
+    if (distinct.empty() || limit == 0)
+        return;
+    std::vector<Cursor> unsorted;
+    for (const std::string &distinctWord : distinct) {
+        unsorted.push_back(cursor(distinctWord));
+        if (unsorted.back().atEnd())
+            return;
+    }
+    // rarest first, as for search()
+    std::vector<size_t> rarest(distinct.size());
+    for (size_t i = 0; i < rarest.size(); ++i)
+        rarest[i] = i;
+    std::sort(rarest.begin(), rarest.end(),
+              [&](size_t x, size_t y) { return unsorted[x].songCount() < unsorted[y].songCount(); });
+    std::vector<Cursor> cursors;
+    std::vector<size_t> slot(distinct.size());
+    for (size_t i = 0; i < rarest.size(); ++i) {
+        cursors.push_back(unsorted[rarest[i]]);
+        slot[rarest[i]] = i;
+    }
+    for (size_t &phraseWord : phraseWords)
+        phraseWord = slot[phraseWord];
+
+    // the songs with every word come from the ids alone, only those get
+    // their positions decoded
+    std::vector<std::vector<uint32_t>> positions(cursors.size());
+    size_t added = 0;
+    while (alignCursors(cursors)) {
+        for (size_t i = 0; i < cursors.size(); ++i)
+            cursors[i].positions(positions[i]);
+
+        // from every place the first word is, take each next word at its
+        // first place after the one before. that is the shortest stretch
+        // starting there, so the song matches if any of them fits.
+        bool matched = false;
+        for (uint32_t start : positions[phraseWords[0]]) {
+            uint32_t last = start;
+            bool complete = true;
+            for (size_t i = 1; i < phraseWords.size(); ++i) {
+                const std::vector<uint32_t> &at = positions[phraseWords[i]];
+                auto next = std::upper_bound(at.begin(), at.end(), last);
+                if (next == at.end()) {
+                    complete = false;
+                    break;
+                }
+                last = *next;
+            }
+            if (!complete)
+                break; // a later start won't find more room after it
+            if (last - start + 1 <= phraseWords.size() + slop) {
+                matched = true;
+                break;
+            }
+        }
+
+        if (matched) {
+            results.push_back(cursors[0].song());
+            if (++added == limit)
+                return;
+        }
+        cursors[0].next();
+    }
+}
+
+void WordIndex::rankedSearch(std::string_view query, std::vector<uint32_t> &results, size_t limit) const {
+    std::vector<std::string> queryWords;
+    std::string word;
+    size_t pos = 0;
+    while (nextWord(query, pos, word)) {
+        if (std::find(queryWords.begin(), queryWords.end(), word) == queryWords.end())
+            queryWords.push_back(word);
+    }
+    std::vector<Cursor> cursors;
+    cursors.reserve(queryWords.size());
+    for (const std::string &queryWord : queryWords) {
+        Cursor found = cursor(queryWord);
+        if (!found.atEnd())
+            cursors.push_back(found);
+    }
+    if (cursors.empty() || limit == 0)
+        return;
+
+    // the cursors by the song they are on, kept as pointers since a cursor
+    // carries a decoded block
+    std::vector<Cursor *> order;
+    for (Cursor &c : cursors)
+        order.push_back(&c);
+    auto bySong = [](const Cursor *x, const Cursor *y) { return x->song() < y->song(); };
+    std::sort(order.begin(), order.end(), bySong);
+
+    // the best limit songs so far as a heap with the worst on top. songs come
+    // in id order, so a later one only gets in by scoring more than it.
+    struct Hit {
+        float score;
+        uint32_t song;
+    };
+    auto better = [](const Hit &x, const Hit &y) { return x.score > y.score || (x.score == y.score && x.song < y.song); };
+    std::vector<Hit> top;
+    top.reserve(limit + 1);
+    float threshold = 0;
+
+    while (!order.empty()) {
+        // the pivot is the first cursor where the words' best scores so far add
+        // up past the threshold. songs before its song have only the words
+        // ahead of it, so none of them can make it.
+        float upper = 0;
+        size_t pivot = 0;
+        for (; pivot < order.size(); ++pivot) {
+            upper += order[pivot]->maxScore();
+            if (upper > threshold)
+                break;
+        }
+        if (pivot == order.size())
+            break;
+        uint32_t pivotSong = order[pivot]->song();
+        while (pivot + 1 < order.size() && order[pivot + 1]->song() == pivotSong)
+            ++pivot;
+
+        // a tighter bound from the blocks the pivot song falls in. up to the
+        // end of the first of them ending, or the next word's song, nothing
+        // scores more than that.
+        float blockUpper = 0;
+        uint32_t skipTo = pivot + 1 < order.size() ? order[pivot + 1]->song() : UINT32_MAX;
+        for (size_t i = 0; i <= pivot; ++i) {
+            uint32_t block = order[i]->blockFor(pivotSong);
+            if (block == order[i]->endBlock)
+                continue;
+            blockUpper += blocks[block].maxScore;
+            skipTo = std::min(skipTo, blocks[block].lastSong + 1);
+        }
+
+        if (blockUpper <= threshold) {
+            for (size_t i = 0; i <= pivot; ++i)
+                order[i]->advance(skipTo);
+        } else if (order[0]->song() == pivotSong) {
+            // every word up to the pivot is on the song, so it gets scored
+            float score = 0;
+            for (size_t i = 0; i <= pivot; ++i) {
+                score += order[i]->score();
+                order[i]->next();
+            }
+            if (top.size() < limit || score > threshold) {
+                top.push_back({score, pivotSong});
+                std::push_heap(top.begin(), top.end(), better);
+                if (top.size() > limit) {
+                    std::pop_heap(top.begin(), top.end(), better);
+                    top.pop_back();
+                }
+                if (top.size() == limit)
+                    threshold = top.front().score;
+            }
+        } else {
+            for (size_t i = 0; i < pivot && order[i]->song() < pivotSong; ++i)
+                order[i]->advance(pivotSong);
+        }
+
+        std::erase_if(order, [](const Cursor *c) { return c->atEnd(); });
+        std::sort(order.begin(), order.end(), bySong);
+    }
+
+    std::sort(top.begin(), top.end(), better);
+    for (const Hit &hit : top)
+        results.push_back(hit.song);
+}
+
+size_t WordIndex::memoryUsage() const {
+    return words.capacity() + wordOffsets.capacity() * sizeof(uint32_t) + terms.capacity() * sizeof(Term)
+         + blocks.capacity() * sizeof(Block) + songData.capacity() + frequencyData.capacity()
+         + positionData.capacity() + lengthNorms.capacity() * sizeof(float);
+}
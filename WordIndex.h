@@ -0,0 +1,146 @@
+//
+// Inverted index over the words of one song field, the lyrics unless told
+// otherwise: for every word, the songs that use it and how often. Postings
+// are kept in blocks of 128 songs, ids as differences and counts as they
+// are, both StreamVByte coded, with each block's last id kept aside so a
+// cursor can skip blocks without decoding them. Ranked
+// queries score by BM25 and use each block's best score to skip the blocks
+// that cannot make the top k (Block-Max WAND). Where in the song each word
+// is goes in a stream of its own, only phrase queries decode it.
+//
+
+#ifndef WORDINDEX_H
+#define WORDINDEX_H
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Songs.h"
+
+class WordIndex {
+public:
+    static constexpr size_t blockSize = 128;
+    // BM25 parameters, the usual ones
+    static constexpr float k1 = 1.2f;
+    static constexpr float b = 0.75f;
+
+private:
+    struct Term {
+        uint32_t firstBlock;
+        uint32_t blockCount;
+        uint32_t songCount; // songs using the word
+        float weight;       // idf * (k1 + 1)
+        float maxScore;     // the best score the word gives any song
+    };
+    struct Block {
+        uint32_t lastSong;        // skip data, the largest id in the block
+        uint32_t songOffset;      // into songData
+        uint32_t frequencyOffset; // into frequencyData
+        uint32_t positionOffset;  // into positionData
+        uint32_t count;
+        float maxScore;           // the best score in the block
+    };
+
+public:
+    // walks one word's postings in id order, decoding a block at a time
+    class Cursor {
+    public:
+        bool atEnd() const { return block == endBlock; }
+        uint32_t song() const { return songs[position]; }
+        // times the word is in song(), the counts are only decoded if asked for
+        uint32_t frequency() const;
+        void next();
+        // moves to the first posting at or past song, whole blocks that end
+        // before it are skipped by their last id without being decoded
+        void advance(uint32_t song);
+        // songs in the whole list
+        uint32_t songCount() const { return listSongs; }
+        // the word's BM25 score for song()
+        float score() const;
+        // no song scores more than this for the word
+        float maxScore() const { return listMaxScore; }
+        // where the word is in song(), counted in words from 0, ascending
+        void positions(std::vector<uint32_t> &out) const;
+
+    private:
+        friend class WordIndex;
+        void load(uint32_t block);
+        // the block song would be in, found by the skip data alone, or
+        // endBlock if the list ends before it
+        uint32_t blockFor(uint32_t song) const;
+
+        const WordIndex *index = nullptr;
+        uint32_t firstBlock = 0;
+        uint32_t block = 0;
+        uint32_t endBlock = 0;
+        uint32_t listSongs = 0;
+        float weight = 0;
+        float listMaxScore = 0;
+        uint32_t position = 0;
+        uint32_t count = 0;
+        mutable bool frequenciesLoaded = false;
+        // positions() walks forward through the block's position data, this
+        // is how far it got
+        mutable uint32_t positionPosting = 0;
+        mutable uint32_t positionByte = 0;
+        uint32_t songs[blockSize];
+        mutable uint32_t frequencies[blockSize];
+    };
+
+    // replaces whatever was there with an index over field of the songs, the
+    // words are split on threadCount threads (0 means one per core)
+    void build(const std::vector<Songs> &songs, std::string_view Songs::*field = &Songs::text,
+               unsigned threadCount = 0);
+
+    // appends the ids of songs whose lyrics have every word of query, in id
+    // order, skipping offset of them and stopping after limit
+    void search(std::string_view query, std::vector<uint32_t> &results,
+                size_t limit = SIZE_MAX, size_t offset = 0) const;
+
+    // appends the ids of the limit songs whose lyrics match query best by
+    // BM25, best first (ties go to the lower id). a song needs only some of
+    // the words.
+    void rankedSearch(std::string_view query, std::vector<uint32_t> &results, size_t limit = 10) const;
+
+    // appends the ids of songs whose lyrics have the words of phrase in
+    // order, in id order and stopping after limit. slop is how many other
+    // words may be between them in all, 0 for the exact phrase.
+    void phraseSearch(std::string_view phrase, std::vector<uint32_t> &results,
+                      size_t limit = SIZE_MAX, size_t slop = 0) const;
+
+    // word is one word as nextWord() gives it. the cursor is at its end if
+    // no song uses the word.
+    Cursor cursor(std::string_view word) const;
+    // appends cursors for the words starting with prefix, the limit most
+    // used ones if there are more. returns how many words start with prefix.
+    size_t prefixCursors(std::string_view prefix, std::vector<Cursor> &out, size_t limit = SIZE_MAX) const;
+
+    size_t wordCount() const { return terms.size(); }
+    size_t postingCount() const { return postings; }
+    size_t memoryUsage() const;
+
+private:
+    // moves the cursors until all are on one song, starting from the first
+    // one's. false once one of them runs out.
+    static bool alignCursors(std::vector<Cursor> &cursors);
+    // index of word in the sorted vocabulary, or terms.size()
+    size_t findTerm(std::string_view word) const;
+    // at its end for terms.size()
+    Cursor cursorAt(size_t term) const;
+    std::string_view wordAt(size_t term) const {
+        return {words.data() + wordOffsets[term], wordOffsets[term + 1] - wordOffsets[term]};
+    }
+
+    std::string words;                // the vocabulary, sorted, back to back
+    std::vector<uint32_t> wordOffsets;
+    std::vector<Term> terms;          // same order as the words
+    std::vector<Block> blocks;
+    std::vector<uint8_t> songData;
+    std::vector<uint8_t> frequencyData;
+    std::vector<uint8_t> positionData; // per posting, its positions as differences
+    // per song, k1 * (1 - b + b * words in song / average words in a song)
+    std::vector<float> lengthNorms;
+    size_t postings = 0;
+};
+
+#endif //WORDINDEX_H
@@ -0,0 +1,133 @@
+//
+// Times the title indexes side by side on the song csv, no window needed.
+//   SongBench [csv file] [queries]
+//
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "MappedFile.h"
+#include "SearchEngine.h"
+#include "SongLoader.h"
+#include "SuffixArrayIndex.h"
+#include "TitleKey.h"
+#include "WordIndex.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double millisecondsSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// prefixes of random titles, 1 to 8 bytes, what someone typing would send
+std::vector<std::string> makeQueries(const std::vector<Songs> &songs, size_t count) {
+    std::mt19937 random(12345);
+    std::vector<std::string> queries;
+    queries.reserve(count);
+    while (queries.size() < count && !songs.empty()) {
+        std::string_view name = songs[random() % songs.size()].name;
+        queries.emplace_back(name.substr(0, 1 + random() % 8));
+    }
+    return queries;
+}
+
+// 1 to 4 words from the lyrics of random songs
+std::vector<std::string> makeLyricsQueries(const std::vector<Songs> &songs, size_t count) {
+    std::mt19937 random(54321);
+    std::vector<std::string> queries;
+    queries.reserve(count);
+    std::string word;
+    while (queries.size() < count && !songs.empty()) {
+        std::string_view text = songs[random() % songs.size()].text;
+        std::string query;
+        size_t pos = text.empty() ? 0 : random() % text.size();
+        for (size_t words = 1 + random() % 4; words > 0 && nextWord(text, pos, word); --words)
+            query += word + ' ';
+        if (!query.empty())
+            queries.push_back(std::move(query));
+    }
+    return queries;
+}
+
+// runs search over every query, returns ns per query. checksum keeps the
+// work from being optimized away and lets the engines be compared.
+template <typename Search>
+double timeQueries(const std::vector<std::string> &queries, Search search, uint64_t &checksum) {
+    std::vector<uint32_t> results;
+    checksum = 0;
+    auto start = Clock::now();
+    for (const std::string &query : queries) {
+        results.clear();
+        search(query, results);
+        for (uint32_t id : results)
+            checksum = checksum * 31 + id;
+    }
+    return millisecondsSince(start) * 1e6 / static_cast<double>(queries.size());
+}
+
+}
+
+int main(int argc, char **argv) {
+    std::string csvFile = argc > 1 ? argv[1] : "spotify_millsongdata.csv";
+    size_t queryCount = argc > 2 ? std::stoul(argv[2]) : 200000;
+
+    MappedFile file(csvFile, MappedFile::Access::Sequential);
+    if (!file.isOpen())
+        return 1;
+    auto start = Clock::now();
+    std::vector<Songs> songs = loadSongs(file);
+    std::cout << songs.size() << " songs loaded in " << millisecondsSince(start) << " ms\n";
+    std::vector<std::string> queries = makeQueries(songs, queryCount);
+    constexpr size_t limit = 10;
+
+    // every prefix engine is checked against the first one on a few of the
+    // queries, then timed on all of them. the map scans every title per
+    // query, so it is only timed on the few.
+    std::vector<std::string> checkQueries(queries.begin(), queries.begin() + static_cast<ptrdiff_t>(std::min<size_t>(queries.size(), 200)));
+    uint64_t expected = 0;
+    uint64_t checksum;
+    double perQuery;
+    for (std::string_view engineName : searchEngineNames()) {
+        std::unique_ptr<SearchEngine> engine = makeSearchEngine(engineName);
+        std::string name(engineName);
+        name.resize(14, ' ');
+        start = Clock::now();
+        engine->build(songs);
+        std::cout << name << "build " << millisecondsSince(start) << " ms, " << engine->memoryUsage() / 1e6 << " MB\n";
+        auto search = [&](const std::string &q, std::vector<uint32_t> &r) { engine->prefixSearch(q, r, limit); };
+        perQuery = timeQueries(checkQueries, search, checksum);
+        if (engineName == searchEngineNames().front())
+            expected = checksum;
+        bool differs = checksum != expected;
+        if (engineName != "map")
+            perQuery = timeQueries(queries, search, checksum);
+        std::cout << name << perQuery << " ns/query" << (differs ? " (results differ!)" : "") << "\n";
+    }
+
+    // matches anywhere in the title, so more (and other) results than the rest
+    start = Clock::now();
+    SuffixArrayIndex suffixIndex;
+    suffixIndex.build(songs);
+    std::cout << "suffix array  build " << millisecondsSince(start) << " ms, "
+              << suffixIndex.memoryUsage() / 1e6 << " MB\n";
+    perQuery = timeQueries(queries, [&](const std::string &q, std::vector<uint32_t> &r) {
+        suffixIndex.search(q, r, limit);
+    }, checksum);
+    std::cout << "suffix array  " << perQuery << " ns/query (infix)\n";
+
+    start = Clock::now();
+    WordIndex lyricsIndex;
+    lyricsIndex.build(songs);
+    std::cout << "lyrics        build " << millisecondsSince(start) << " ms, "
+              << lyricsIndex.memoryUsage() / 1e6 << " MB\n";
+    std::vector<std::string> lyricsQueries = makeLyricsQueries(songs, std::max<size_t>(queryCount / 100, 1));
+    perQuery = timeQueries(lyricsQueries, [&](const std::string &q, std::vector<uint32_t> &r) {
+        lyricsIndex.rankedSearch(q, r, limit);
+    }, checksum);
+    std::cout << "lyrics        " << perQuery << " ns/query (BM25 top " << limit << ")\n";
+    return 0;
+}
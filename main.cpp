@@ -1,161 +1,95 @@
 #include <iostream>
 #include <SFML/Graphics.hpp>
-#include <fstream>
-#include <sstream>
 #include <vector>
+#include "ArtistIndex.h"
+#include "MappedFile.h"
+#include "SearchEngine.h"
+#include "Snapshot.h"
+#include "SongLoader.h"
+#include "SongQuery.h"
 #include "Songs.h"
+#include "Trie.h"
+#include "WordIndex.h"
+#include <iterator>
 #include <string>
-#include <memory>
-#include <unordered_map>
 
 
-/*
- *In order to use the standard library map you must uncomment the map parts
- *and then comment out the trie parts
- */
-
-std::vector<Songs> loadSongs(const std::string& fileName) {
-    std::vector<Songs> songs;
-    std::ifstream file(fileName);
-
-    if (!file.is_open()) {
-        std::cerr << "Error opening file " << fileName << std::endl;
-        return songs;
-    }
-
-    std::string line;
-    std::getline(file, line);
-
-    while (std::getline(file, line)) {
-        std::stringstream ss(line);
-        std::string songName;
-        std::string songAuthor;
-
-        std::getline(ss, songAuthor, ',');
-        std::getline(ss, songName, ',');
-
-        Songs song;
-        song.name = songName;
-        song.author = songAuthor;
-
-        songs.emplace_back(song);
-    }
-    file.close();
-    return songs;
-
+//song titles and the search box are UTF-8, sfml needs to be told so
+sf::String fromUtf8(const std::string &str) {
+    return sf::String::fromUtf8(str.begin(), str.end());
 }
 
-//makes node for trie
-struct TrieNode {
-    bool isEndOfWord;
-    std::vector<std::pair<std::string, std::string>> songs; // Pair of <Author, Song Name>
-    std::shared_ptr<TrieNode> children[26];
-
-    TrieNode() : isEndOfWord(false) {
-        for (auto &child : children)
-            child = nullptr;
+int main(int argc, char **argv)
+{
+    const std::string csvFile = "spotify_millsongdata.csv";
+    const std::string snapshotFile = "spotify_millsongdata.snapshot";
+
+    //--engine=NAME answers title searches with that engine instead of the trie, to compare them on the same songs
+    std::unique_ptr<SearchEngine> engine;
+    const std::string engineFlag = "--engine=";
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        if (arg.starts_with(engineFlag)) {
+            engine = makeSearchEngine(arg.substr(engineFlag.size()));
+            if (!engine) {
+                std::cerr << "Unknown engine " << arg.substr(engineFlag.size()) << ", the engines are:";
+                for (std::string_view name : searchEngineNames())
+                    std::cerr << " " << name;
+                std::cerr << std::endl;
+                return 1;
+            }
+        }
     }
-};
 
-//makes lowercase for trie
-int charToIndex(char c) {
-    return tolower(c) - 'a';
-}
+    //This is the vector of songs, they point into songFile (the csv or the snapshot) so it stays open
+    MappedFile songFile;
+    std::vector<Songs> songs;
+    Trie songTrie;
 
-/* Uncomment for map stuff
-//makes lowercase for map
-std::string toLower(const std::string &str) {
-    std::string lowerStr;
-    for (char c : str) {
-        lowerStr += std::tolower(c);
-    }
-    return lowerStr;
-}
+    //the snapshot already has the songs and the trie, only rebuild if the csv changed since
+    if (!snapshotIsFresh(snapshotFile, csvFile) || !loadSnapshot(snapshotFile, songFile, songs, songTrie)) {
+        songFile = MappedFile(csvFile, MappedFile::Access::Sequential);
+        songs = loadSongs(songFile);
 
-//checks if str starts with prefix
-bool startsWith(const std::string &str, const std::string &prefix) {
-    std::string lowerStr = toLower(str);
-    std::string lowerPrefix = toLower(prefix);
-    return lowerStr.find(lowerPrefix) == 0;
-}
-*/
+        //this was just a test to see if it loaded into the vector
 
-//beginning of trie class
-class Trie {
-private:
-    std::shared_ptr<TrieNode> root;
+        // for (size_t i = 0; i < std::min(songs.size(), size_t(10)); ++i) {
+        //     std::cout << "Name: " << songs[i].name << ", Author: " << songs[i].author << std::endl;
+        // }
 
-public:
-    Trie() {
-        root = std::make_shared<TrieNode>();
-    }
 
-    void insert(const std::string &songName, const std::string &author) {
-        auto node = root;
-        for (char c : songName) {
-            if (!isalpha(c))
-                continue;
-            int index = charToIndex(c);
-            if (!node->children[index])
-                node->children[index] = std::make_shared<TrieNode>();
-            node = node->children[index];
+        //puts vector of songs into trie, the trie only keeps each song's index
+        songTrie.build(songs);
+        //a missing or unreadable csv loads nothing, and an empty snapshot would hide the csv once it turns up
+        if (songFile.isOpen() && !songs.empty()) {
+            writeSnapshot(snapshotFile, csvFile, songs, songTrie);
         }
-        node->isEndOfWord = true;
-        node->songs.push_back({author, songName});
     }
 
-    void search(const std::string &query, std::vector<std::pair<std::string, std::string>> &results) {
-        auto node = root;
-        for (char c : query) {
-            if (!isalpha(c))
-                continue;
-            int index = charToIndex(c);
-            if (!node->children[index])
-                return;
-            node = node->children[index];
-        }
-        collectAllSongs(node, results);
-    }
-private:
-    void collectAllSongs(std::shared_ptr<TrieNode> node, std::vector<std::pair<std::string, std::string>> &results) {
-        if (node->isEndOfWord) {
-            for (const auto &song : node->songs)
-                results.push_back(song);
-        }
-        for (int i = 0; i < 26; ++i) {
-            if (node->children[i])
-                collectAllSongs(node->children[i], results);
-        }
+    //every node remembers its best five songs, so a search is just the prefix walk
+    songTrie.buildTopK(5);
+    if (engine) {
+        //the trie engine searches songTrie rather than building a second copy of it
+        if (engine->name() == "trie")
+            engine = makeTrieEngine(songTrie);
+        else
+            engine->build(songs);
     }
-};
-
-int main()
-{
-    //This is the vector of songs
-    std::vector<Songs> songs = loadSongs("spotify_millsongdata.csv");
-
-    //this was just a test to see if it loaded into the vector
-
-    // for (size_t i = 0; i < std::min(songs.size(), size_t(10)); ++i) {
-    //     std::cout << "Name: " << songs[i].name << ", Author: " << songs[i].author << std::endl;
-    // }
-
 
-    //puts vector of songs into trie
-    Trie songTrie;
-    for (const auto &song : songs) {
-        songTrie.insert(song.name, song.author);
-    }
+    //second index over the same songs, by artist. it matches the start of the whole name, so "artist:the be" finds The Beatles,
+    //which artistWords below can't: that one only knows single words, for the query language
+    ArtistIndex artistIndex;
+    artistIndex.build(songs);
 
-    /* Uncomment for map stuff
-    //creates unordered map and key is the song name in lowercase
-    std::unordered_map<std::string, std::vector<std::pair<std::string, std::string>>> songMap;
+    //the lyrics index takes a couple of seconds, so it waits for the first lyrics search
+    WordIndex lyricsIndex;
+    bool lyricsIndexBuilt = false;
 
-    for (const auto &song : songs) {
-        std::string lowerName = toLower(song.name);
-        songMap[lowerName].emplace_back(song.author, song.name);
-    }
-    */
+    //word indexes over the titles and artists for the query language, these are quick
+    WordIndex titleWords;
+    titleWords.build(songs, &Songs::name);
+    WordIndex artistWords;
+    artistWords.build(songs, &Songs::author);
 
     // create the window
     sf::RenderWindow window(sf::VideoMode(800, 600), "Song Searcher");
@@ -224,38 +158,60 @@ int main()
                 window.close();
             }
             if (event.type == sf::Event::TextEntered) {
-                if (event.key.code == sf::Keyboard::Enter or event.key.code == 10) {
+                //a text event only has event.text, the key codes are a different member of the union (Enter there is 58, a ':')
+                if (event.text.unicode == '\r' or event.text.unicode == '\n') {
 
-                    //stuff for trie
-
-                    //vector of the results of search
-                    std::vector<std::pair<std::string, std::string>> results;
+                    //vector of the results of search, as indexes into songs
+                    std::vector<uint32_t> results;
 
                     //vector of just top 5
                     std::vector<std::string> topFiveSongs;
 
-                    /* Uncomment for map stuff
-                    //stuff for map
-                    std::string lowerInput = toLower(input);
-                    for (const auto& pair : songMap) {
-                        if (startsWith(pair.first, lowerInput)) {
-                            for (const auto& songInfo : pair.second) {
-                                results.push_back(songInfo);
-                            }
+                    //"artist:" searches the rest by artist instead of title, "lyrics:" for the songs whose lyrics match the words best
+                    const std::string artistPrefix = "artist:";
+                    const std::string lyricsPrefix = "lyrics:";
+                    //"Artist:" works too, the field names are lower cased like titleKey lower cases the titles
+                    const std::string search = foldFields(input);
+                    if (!lyricsIndexBuilt && search.find(lyricsPrefix) != std::string::npos) {
+                        lyricsIndex.build(songs);
+                        lyricsIndexBuilt = true;
+                    }
+                    if (isQuery(search)) {
+                        //AND/OR/NOT and the rest, only the five shown get looked for
+                        QueryIndexes indexes {&titleWords, &artistWords, lyricsIndexBuilt ? &lyricsIndex : nullptr, songs.size()};
+                        if (auto query = parseQuery(search, indexes)) {
+                            takeSongs(*query, results, 5);
+                        }
+                    } else if (search.starts_with(artistPrefix)) {
+                        artistIndex.search(std::string_view(search).substr(artistPrefix.size()), results, 5);
+                    } else if (search.starts_with(lyricsPrefix)) {
+                        //a line in quotes has to be in the lyrics word for word
+                        std::string_view words = std::string_view(search).substr(lyricsPrefix.size());
+                        size_t quote = words.find('"');
+                        if (quote != std::string_view::npos) {
+                            std::string_view line = words.substr(quote + 1);
+                            lyricsIndex.phraseSearch(line.substr(0, line.find('"')), results, 5);
+                        } else {
+                            lyricsIndex.rankedSearch(words, results, 5);
+                        }
+                    } else if (engine) {
+                        engine->prefixSearch(input, results, 5);
+                    } else {
+                        songTrie.top(input, results);
+                        //nothing starts with it, so maybe it has a typo. longer input can take two
+                        if (results.empty()) {
+                            songTrie.fuzzySearch(input, input.size() > 5 ? 2 : 1, results, 5);
                         }
                     }
-                    */
-
-
-                    songTrie.search(input, results);
                     if (results.empty()) {
                         //if no songs found
                         topFiveSongs.push_back("No songs found for the term \"" + input + "\".");
                     } else {
                         //sets top five results in top five vector
                         int count = 0;
-                        for (const auto &song : results) {
-                            std::string formattedString = song.second + " by " + song.first;
+                        for (uint32_t id : results) {
+                            const Songs &song = songs[id];
+                            std::string formattedString = std::string(song.name) + " by " + std::string(song.author);
                             topFiveSongs.push_back(formattedString);
                             if (++count == 5)
                                 break;
@@ -278,7 +234,7 @@ int main()
                     sf::Sprite backgroundSprite2(background2);
 
 
-                    sf::Text songtitle(input,font,25);
+                    sf::Text songtitle(fromUtf8(input),font,25);
                     songtitle.setFillColor(sf::Color::Black);
                     songtitle.setPosition(330, 100);
 
@@ -290,7 +246,7 @@ int main()
                     num1.setFillColor(sf::Color::Black);
                     num1.setPosition(100, 150);
 
-                    sf::Text num1answer(name1, font, 30);
+                    sf::Text num1answer(fromUtf8(name1), font, 30);
                     num1answer.setFillColor(sf::Color::Black);
                     num1answer.setPosition(150, 150);
 
@@ -299,7 +255,7 @@ int main()
                     num2.setFillColor(sf::Color::Black);
                     num2.setPosition(100, 200);
 
-                    sf::Text num2answer(name2, font, 30);
+                    sf::Text num2answer(fromUtf8(name2), font, 30);
                     num2answer.setFillColor(sf::Color::Black);
                     num2answer.setPosition(150, 200);
 
@@ -308,7 +264,7 @@ int main()
                     num3.setFillColor(sf::Color::Black);
                     num3.setPosition(100, 250);
 
-                    sf::Text num3answer(name3, font, 30);
+                    sf::Text num3answer(fromUtf8(name3), font, 30);
                     num3answer.setFillColor(sf::Color::Black);
                     num3answer.setPosition(150, 250);
 
@@ -316,7 +272,7 @@ int main()
                     num4.setFillColor(sf::Color::Black);
                     num4.setPosition(100, 300);
 
-                    sf::Text num4answer(name4, font, 30);
+                    sf::Text num4answer(fromUtf8(name4), font, 30);
                     num4answer.setFillColor(sf::Color::Black);
                     num4answer.setPosition(150, 300);
 
@@ -324,7 +280,7 @@ int main()
                     num5.setFillColor(sf::Color::Black);
                     num5.setPosition(100, 350);
 
-                    sf::Text num5answer(name5, font, 30);
+                    sf::Text num5answer(fromUtf8(name5), font, 30);
                     num5answer.setFillColor(sf::Color::Black);
                     num5answer.setPosition(150, 350);
 
@@ -367,22 +323,24 @@ int main()
                         window2.display();
                     }
                 }
-                if (event.text.unicode == sf::Keyboard::Backspace
-                    or event.text.unicode == 8) {
+                else if (event.text.unicode == '\b') {
+                    //drops the whole last character, which can be several UTF-8 bytes
+                    while (!input.empty() && (static_cast<unsigned char>(input.back()) & 0xC0) == 0x80) input.pop_back();
                     if (!input.empty()) input.pop_back();
-                    bline.setString(input+'|');
+                    bline.setString(fromUtf8(input+'|'));
                     }
                 else {
                     // if (isalpha(event.text.unicode)) {
-                        char c = (char)event.text.unicode;
+                        //input is kept as UTF-8 so titles in any language can be searched
+                        sf::Uint32 c = event.text.unicode;
                         // if (input.size() == 0) {
                         //     c = std::toupper(event.text.unicode);
                         // }
                         // else {
                         //     c = std::tolower(event.text.unicode);
                         // }
-                        input += c;
-                        bline.setString(input+'|');
+                        sf::Utf8::encode(c, std::back_inserter(input));
+                        bline.setString(fromUtf8(input+'|'));
 
                    // }
                 }